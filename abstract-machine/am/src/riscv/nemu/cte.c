@@ -8,7 +8,17 @@ Context* __am_irq_handle(Context *c) {
   if (user_handler) {
     Event ev = {0};
     switch (c->mcause) {
-      default: ev.event = EVENT_ERROR; break;
+      case EXC_ECALL_M:
+        ev.event = (c->GPR1 == -1 ? EVENT_YIELD : EVENT_SYSCALL);
+        c->mepc += 4;
+        break;
+      case IRQ_M_TIMER: ev.event = EVENT_IRQ_TIMER; break;
+      case IRQ_M_EXT:   ev.event = EVENT_IRQ_IODEV; break;
+      case EXC_INST_PF: case EXC_LOAD_PF: case EXC_STORE_PF:
+        ev.event = EVENT_PAGEFAULT;
+        asm volatile("csrr %0, mtval" : "=r"(ev.ref));
+        break;
+      default: ev.event = EVENT_ERROR; ev.cause = c->mcause; break;
     }
 
     c = user_handler(ev, c);
@@ -31,7 +41,12 @@ bool cte_init(Context*(*handler)(Event, Context*)) {
 }
 
 Context *kcontext(Area kstack, void (*entry)(void *), void *arg) {
-  return NULL;
+  Context *c = (Context *)kstack.end - 1;
+  memset(c, 0, sizeof(*c));
+  c->mepc = (uintptr_t)entry;
+  c->mstatus = MSTATUS_MPP | MSTATUS_MPIE;
+  c->GPR2 = (uintptr_t)arg;
+  return c;
 }
 
 void yield() {
@@ -43,8 +58,16 @@ void yield() {
 }
 
 bool ienabled() {
-  return false;
+  uintptr_t mstatus;
+  asm volatile("csrr %0, mstatus" : "=r"(mstatus));
+  return (mstatus & MSTATUS_MIE) != 0;
 }
 
 void iset(bool enable) {
+  if (enable) {
+    asm volatile("csrs mie, %0" : : "r"(MIE_MTIE | MIE_MEIE));
+    asm volatile("csrsi mstatus, %0" : : "i"(MSTATUS_MIE));
+  } else {
+    asm volatile("csrci mstatus, %0" : : "i"(MSTATUS_MIE));
+  }
 }
@@ -0,0 +1,43 @@
+#include <am.h>
+#include <stdatomic.h>
+#include <klib-macros.h>
+#include "mpe.h"
+
+int __am_ncpu = 1;                     // set by _start from a1
+volatile uintptr_t __am_mpe_stack = 0; // top of the stacks of the other harts
+static void (* volatile user_entry)();
+
+static void call_user_entry() {
+  user_entry();
+  panic("MPE entry should not return");
+}
+
+bool mpe_init(void (*entry)()) {
+  user_entry = entry;
+  // the other harts are spinning in _start, and take their stacks
+  // from the top of the heap once __am_mpe_stack is set
+  uintptr_t top = (uintptr_t)heap.end;
+  heap.end = (void *)(top - (__am_ncpu - 1) * MPE_STACK_SIZE);
+  atomic_thread_fence(memory_order_seq_cst);
+  __am_mpe_stack = top;
+  call_user_entry();
+  return true;
+}
+
+void __am_othercpu_entry() {
+  call_user_entry();
+}
+
+int cpu_count() {
+  return __am_ncpu;
+}
+
+int cpu_current() {
+  int id;
+  asm volatile("csrr %0, mhartid" : "=r"(id));
+  return id;
+}
+
+int atomic_xchg(int *addr, int newval) {
+  return atomic_exchange(addr, newval);
+}
@@ -0,0 +1,8 @@
+#ifndef RISCV_NEMU_MPE_H__
+#define RISCV_NEMU_MPE_H__
+
+// the stack of each hart other than hart 0, also used by start.S
+#define MPE_STACK_SHIFT 15
+#define MPE_STACK_SIZE  (1 << MPE_STACK_SHIFT)
+
+#endif
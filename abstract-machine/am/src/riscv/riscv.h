@@ -19,7 +19,21 @@ static inline void outl(uintptr_t addr, uint32_t data) { *(volatile uint32_t *)a
 #define PTE_A 0x40
 #define PTE_D 0x80
 
+#define MIE_MTIE (1 << 7)
+#define MIE_MEIE (1 << 11)
+
+#define MCAUSE_INTR   ((uintptr_t)1 << (__riscv_xlen - 1))
+#define IRQ_M_TIMER   (MCAUSE_INTR | 7)
+#define IRQ_M_EXT     (MCAUSE_INTR | 11)
+#define EXC_ECALL_M   11
+#define EXC_INST_PF   12
+#define EXC_LOAD_PF   13
+#define EXC_STORE_PF  15
+
 enum { MODE_U, MODE_S, MODE_M = 3 };
+#define MSTATUS_MIE  (1 << 3)
+#define MSTATUS_MPIE (1 << 7)
+#define MSTATUS_MPP  (MODE_M << 11)
 #define MSTATUS_MXR  (1 << 19)
 #define MSTATUS_SUM  (1 << 18)
 
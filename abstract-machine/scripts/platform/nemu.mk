@@ -12,6 +12,9 @@ LDFLAGS   += -T $(AM_HOME)/scripts/linker.ld \
              --defsym=_pmem_start=0x80000000 --defsym=_entry_offset=0x0
 LDFLAGS   += --gc-sections -e _start
 NEMUFLAGS += -l $(shell dirname $(IMAGE).elf)/nemu-log.txt
+# whether the option CONFIG_$(1) is enabled in the NEMU under $(NEMU_HOME)
+nemu_config = $(shell grep -s '^CONFIG_$(1)=y' $(NEMU_HOME)/include/config/auto.conf)
+NEMUFLAGS += -e $(IMAGE).elf
 
 CFLAGS += -DMAINARGS=\"$(mainargs)\"
 CFLAGS += -I$(AM_HOME)/am/src/platform/nemu/include
@@ -1,10 +1,15 @@
 include $(AM_HOME)/scripts/isa/riscv.mk
 include $(AM_HOME)/scripts/platform/nemu.mk
 CFLAGS  += -DISA_H=\"riscv/riscv.h\"
-COMMON_CFLAGS += -march=rv32em_zicsr -mabi=ilp32e  # overwrite
+# compressed and bit manipulation instructions only if NEMU is built with them
+RV_EXT_C := $(if $(call nemu_config,RVC),c)
+RV_EXT_ZB := $(if $(call nemu_config,RV_ZB),_zba_zbb_zbs)
+COMMON_CFLAGS += -march=rv32ema$(RV_EXT_C)_zicsr$(RV_EXT_ZB) -mabi=ilp32e # overwrite
 LDFLAGS       += -melf32lriscv                     # overwrite
 
+AM_SRCS := $(filter-out platform/nemu/mpe.c,$(AM_SRCS))
 AM_SRCS += riscv/nemu/start.S \
            riscv/nemu/cte.c \
            riscv/nemu/trap.S \
-           riscv/nemu/vme.c
+           riscv/nemu/vme.c \
+           riscv/nemu/mpe.c
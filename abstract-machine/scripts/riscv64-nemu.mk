@@ -2,7 +2,9 @@ include $(AM_HOME)/scripts/isa/riscv.mk
 include $(AM_HOME)/scripts/platform/nemu.mk
 CFLAGS  += -DISA_H=\"riscv/riscv.h\"
 
+AM_SRCS := $(filter-out platform/nemu/mpe.c,$(AM_SRCS))
 AM_SRCS += riscv/nemu/start.S \
            riscv/nemu/cte.c \
            riscv/nemu/trap.S \
-           riscv/nemu/vme.c
+           riscv/nemu/vme.c \
+           riscv/nemu/mpe.c
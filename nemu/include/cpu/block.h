@@ -0,0 +1,123 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_BLOCK_H__
+#define __CPU_BLOCK_H__
+
+#include <common.h>
+#include <memory/vaddr.h>
+
+/* Interface of the engines running basic blocks as a whole, namely
+ * ENGINE_DBT and ENGINE_THREADED. Cold code and single steps are
+ * still interpreted by exec_once() in cpu-exec.c.
+ */
+
+// maximum number of guest instructions in a block
+#define BLOCK_MAX_INSTR 64
+
+/* A block never crosses a page, so that it is dropped with the page.
+ * With RVC, the instruction in the last 2 bytes of a page may cross the
+ * page, so it is always interpreted, and blocks end before it.
+ */
+static inline bool block_may_cross_page(vaddr_t pc) {
+  return MUXDEF(CONFIG_RVC, (pc & PAGE_MASK) == PAGE_SIZE - 2, false);
+}
+
+/* Run the block starting at `pc', building it first if needed. Blocks
+ * are chained to the blocks following them, which run without going
+ * back to the caller while at least BLOCK_MAX_INSTR of the `n' guest
+ * instructions remain. Return the number of guest instructions executed,
+ * or 0 if the instruction at `pc' should be interpreted.
+ */
+uint64_t block_exec(vaddr_t pc, uint64_t n);
+/* Return the number of guest instructions executed before the current
+ * one in the run of block_exec(), which are not counted in
+ * g_nr_guest_inst yet, or 0 if no block is running. It is only kept for
+ * instructions accessing memory or CSRs.
+ */
+uint64_t block_nr_inst();
+/* Return the PC of the current instruction, which is not kept in cpu.pc
+ * within a block. It is only kept for the instructions as in
+ * block_nr_inst(), and is cpu.pc if no block is running.
+ */
+vaddr_t block_pc();
+/* Called when an instruction raises an exception. If it is in a block,
+ * which is left in the middle, set cpu.pc to the instruction, and return
+ * block_nr_inst(). Otherwise, return 0.
+ */
+uint64_t block_exception();
+/* Drop the blocks overlapping with [addr, addr + len). */
+void block_invalidate(paddr_t addr, int len);
+/* Drop all blocks, e.g. when the address translation changes. */
+void block_flush();
+void block_statistic();
+
+#ifdef CONFIG_ENGINE_THREADED
+#include <cpu/decode.h>
+#include <isa-all-instr.h>
+
+// number of blocks chained to the end of a block, which are the
+// targets of its last instruction seen recently
+#define BLOCK_NR_LINK 4
+#define BLOCK_LINK_INVALID ((vaddr_t)1)
+
+struct ThreadedInst;
+typedef struct {
+  vaddr_t pc;
+  struct ThreadedInst *inst; // the first instruction of the block at `pc'
+} BlockLink;
+
+typedef struct ThreadedInst {
+  const void *handler; // label of the instruction in isa_exec_threaded()
+  Decode s;
+  BlockLink *link; // for THREADED_END, the chained blocks
+} ThreadedInst;
+
+static inline ThreadedInst* block_chained(BlockLink *link, vaddr_t pc) {
+  int i;
+  for (i = 0; i < BLOCK_NR_LINK; i ++) {
+    if (link[i].pc == pc) return link[i].inst;
+  }
+  return NULL;
+}
+
+/* Labels of the handlers in isa_exec_threaded(), indexed by instruction
+ * IDs, followed by THREADED_END which ends the block normally, and
+ * THREADED_STALE which ends it before an instruction which is dropped,
+ * and then the handlers of fused instructions. Filled by
+ * isa_exec_threaded(NULL, 0).
+ */
+enum { THREADED_END = NR_INSTR, THREADED_STALE, NR_THREADED_HANDLER };
+extern const void **isa_threaded_handler;
+/* THREADED_END where the last run of isa_exec_threaded() left, which
+ * can be chained to the block at cpu.pc, or NULL.
+ */
+extern ThreadedInst *isa_threaded_exit;
+/* Run the threaded code from `t' until the end of the block, and go on
+ * with the chained blocks while at least BLOCK_MAX_INSTR of the `limit'
+ * instructions remain. Return the number of instructions executed.
+ */
+uint64_t isa_exec_threaded(ThreadedInst *t, uint64_t limit);
+/* Return the number of instructions executed before the current one in
+ * the run of isa_exec_threaded(), and its PC in `pc'.
+ */
+uint64_t isa_threaded_position(vaddr_t *pc);
+/* Fuse the pairs of instructions executed as one in the block of `n'
+ * instructions at `t'. */
+void isa_threaded_fuse(ThreadedInst *t, int n);
+void isa_threaded_statistic();
+#endif
+
+#endif
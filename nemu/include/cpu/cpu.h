@@ -20,6 +20,49 @@
 
 void cpu_exec(uint64_t n);
 
+#ifdef CONFIG_SMP
+extern __thread int g_hart_id;
+#define hart_id() g_hart_id
+/* Run all harts for `n' instructions each, see src/cpu/smp.c. */
+void smp_exec(uint64_t n);
+/* Run the hart of the calling thread for `n' instructions. */
+void cpu_exec_hart(uint64_t n);
+uint64_t smp_nr_guest_inst();
+uint64_t smp_nr_dcache_hit();
+uint64_t smp_nr_dcache_miss();
+/* Flush the soft TLBs of all harts. The calling hart flushes at once,
+ * and the others before their next instructions, see smp_check().
+ */
+void smp_soft_tlb_flush();
+/* Do what other harts asked for, when g_intr_check is cleared. */
+void smp_check();
+/* Reserve the word at the host address `haddr' for LR, or nothing if it
+ * is NULL. Drop the reservation of the calling hart, returning whether
+ * it was still held, i.e. not dropped by stores of other harts.
+ */
+void smp_reserve(void *haddr);
+bool smp_unreserve();
+/* Drop the reservations of other harts which overlap the store to
+ * [haddr, haddr + len). It should be called before the store.
+ */
+extern volatile int g_nr_reservation;
+void smp_drop_reservation(void *haddr, int len);
+#define smp_store(haddr, len) \
+  do { if (unlikely(g_nr_reservation)) smp_drop_reservation(haddr, len); } while (0)
+#else
+#define hart_id() 0
+#endif
+
+/* Set when an interrupt may have become pending or enabled, by devices
+ * or by writes of CSRs. The execution loop only queries the interrupt
+ * with isa_query_intr() at the next block boundary after it is set.
+ */
+extern HART_LOCAL volatile bool g_intr_check;
+/* Abort the current instruction with the exception `NO', and take the
+ * trap in the execution loop, which may be in the middle of a block.
+ */
+void longjmp_exception(word_t NO) __attribute__((noreturn));
+
 void set_nemu_state(int state, vaddr_t pc, int halt_ret);
 void invalid_inst(vaddr_t thispc);
 
@@ -24,15 +24,19 @@ void difftest_skip_ref();
 void difftest_skip_dut(int nr_ref, int nr_dut);
 void difftest_set_patch(void (*fn)(void *arg), void *arg);
 void difftest_step(vaddr_t pc, vaddr_t npc);
+void difftest_intr(word_t NO);
 void difftest_detach();
 void difftest_attach();
+bool difftest_attached();
 #else
 static inline void difftest_skip_ref() {}
 static inline void difftest_skip_dut(int nr_ref, int nr_dut) {}
 static inline void difftest_set_patch(void (*fn)(void *arg), void *arg) {}
 static inline void difftest_step(vaddr_t pc, vaddr_t npc) {}
+static inline void difftest_intr(word_t NO) {}
 static inline void difftest_detach() {}
 static inline void difftest_attach() {}
+static inline bool difftest_attached() { return false; }
 #endif
 
 extern void (*ref_difftest_memcpy)(paddr_t addr, void *buf, size_t n, bool direction);
@@ -17,7 +17,6 @@
 
 #include <memory/vaddr.h>
 
-// for riscv32 length is always 4
 static inline uint32_t inst_fetch(vaddr_t *pc, int len) {
   uint32_t inst = vaddr_ifetch(*pc, len);
   (*pc) += len;
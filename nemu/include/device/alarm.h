@@ -20,5 +20,8 @@
 
 typedef void (*alarm_handler_t) ();
 void add_alarm_handle(alarm_handler_t h);
+/* Call the handlers, which is done by device_update() in virtual time
+ * instead of the host timer. */
+void alarm_fire();
 
 #endif
@@ -21,7 +21,7 @@
 typedef void(*io_callback_t)(uint32_t, int, bool);
 uint8_t* new_space(int size);
 
-typedef struct {
+typedef struct IOMap {
   const char *name;
   // we treat ioaddr_t as paddr_t here
   paddr_t low;
@@ -50,6 +50,14 @@ void add_pio_map(const char *name, ioaddr_t addr,
 void add_mmio_map(const char *name, paddr_t addr,
         void *space, uint32_t len, io_callback_t callback);
 
+/* the only mmio map in the page of `addr', or NULL */
+IOMap* mmio_map_of_page(paddr_t addr);
+
+#ifdef CONFIG_SMP
+void map_lock();
+void map_unlock();
+#endif
+
 word_t map_read(paddr_t addr, int len, IOMap *map);
 void map_write(paddr_t addr, int len, word_t data, IOMap *map);
 
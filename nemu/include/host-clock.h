@@ -0,0 +1,92 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __HOST_CLOCK_H__
+#define __HOST_CLOCK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+/* Host clocks shared by get_time() of src/utils/timer.c and
+ * tools/clock-bench, so that the tool measures the same code.
+ */
+
+static inline uint64_t host_monotonic_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static inline uint64_t host_monotonic_us() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// the cost of `clock' in nanoseconds per call, averaged over `n' calls
+static inline double host_clock_cost(uint64_t (*clock)(), int n) {
+  static volatile uint64_t sink; // keep the calls from being optimized out
+  uint64_t t0 = host_monotonic_ns();
+  int i;
+  for (i = 0; i < n; i ++) sink += clock();
+  return (double)(host_monotonic_ns() - t0) / n;
+}
+
+#if defined(__x86_64__)
+#define HOST_HAS_TSC
+#include <x86intrin.h>
+#include <cpuid.h>
+
+/* The time stamp counter is read without a system call or a vDSO page,
+ * so it usually costs a few nanoseconds. It is converted to microseconds
+ * with a 32.32 fixed-point factor, which is calibrated against
+ * CLOCK_MONOTONIC. Only an invariant TSC ticks at a constant rate
+ * across frequency changes and sleep states.
+ */
+typedef struct {
+  uint64_t base; // TSC at the calibration
+  uint64_t mult; // microseconds per tick, in 32.32 fixed point
+} TSCClock;
+
+static inline bool tsc_invariant() {
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid_max(0x80000000, NULL) < 0x80000007) return false;
+  __cpuid(0x80000007, eax, ebx, ecx, edx);
+  return (edx >> 8) & 1;
+}
+
+// Calibrate `c' over `ns' nanoseconds, and return the frequency of the
+// TSC in MHz, or 0 if the TSC is not invariant.
+static inline uint64_t tsc_calibrate(TSCClock *c, uint64_t ns) {
+  if (!tsc_invariant()) return 0;
+  uint64_t ns0 = host_monotonic_ns(), tsc0 = __rdtsc();
+  uint64_t ns1, tsc1;
+  do {
+    ns1 = host_monotonic_ns();
+    tsc1 = __rdtsc();
+  } while (ns1 - ns0 < ns);
+  uint64_t ticks = tsc1 - tsc0;
+  c->mult = ((ns1 - ns0) << 32) / (ticks * 1000);
+  c->base = tsc0;
+  return ticks * 1000 / (ns1 - ns0);
+}
+
+static inline uint64_t tsc_us(const TSCClock *c) {
+  return ((unsigned __int128)(__rdtsc() - c->base) * c->mult) >> 32;
+}
+#endif
+
+#endif
@@ -27,15 +27,24 @@ typedef concat(__GUEST_ISA__, _ISADecodeInfo) ISADecodeInfo;
 // monitor
 extern unsigned char isa_logo[];
 void init_isa();
+#ifdef CONFIG_SMP
+/* Reset hart `id', which runs in the calling thread. */
+void isa_hart_init(int id);
+#endif
 
 // reg
-extern CPU_state cpu;
+extern HART_LOCAL CPU_state cpu;
 void isa_reg_display();
 word_t isa_reg_str2val(const char *name, bool *success);
 
 // exec
 struct Decode;
 int isa_exec_once(struct Decode *s);
+void isa_fetch_decode(struct Decode *s);
+#ifdef CONFIG_DECODE_CACHE
+void isa_dcache_flush();
+void isa_dcache_invalidate(paddr_t addr, int len);
+#endif
 
 // memory
 enum { MMU_DIRECT, MMU_TRANSLATE, MMU_FAIL };
@@ -45,11 +54,31 @@ enum { MEM_RET_OK, MEM_RET_FAIL, MEM_RET_CROSS_PAGE };
 int isa_mmu_check(vaddr_t vaddr, int len, int type);
 #endif
 paddr_t isa_mmu_translate(vaddr_t vaddr, int len, int type);
+/* Return the exception raised by the failed translation of `vaddr' for
+ * an access of `type', and record `vaddr' for the trap handler, or
+ * INTR_EMPTY if the ISA does not raise one. */
+word_t isa_mmu_fault(vaddr_t vaddr, int type);
+void isa_mmu_statistic();
 
 // interrupt/exception
 vaddr_t isa_raise_intr(word_t NO, vaddr_t epc);
 #define INTR_EMPTY ((word_t)-1)
 word_t isa_query_intr();
+// interrupts raised by devices with dev_raise_intr()
+enum { DEV_IRQ_TIMER, DEV_IRQ_EXTERNAL };
+/* Make the interrupt `irq' of devices pending. It may be called in the
+ * handler of a signal. */
+void isa_dev_raise_intr(int irq);
+
+// devices
+#ifdef CONFIG_RTC_IDLE
+/* Tell whether the load at `pc', which reads the RTC of `len' bytes at
+ * offset `off', is in a loop which only polls the RTC. If the time it
+ * waits for is known, set `*has_deadline', and `*deadline' to its low
+ * word.
+ */
+bool isa_rtc_poll_loop(vaddr_t pc, int off, int len, bool *has_deadline, word_t *deadline);
+#endif
 
 // difftest
 bool isa_difftest_checkregs(CPU_state *ref_r, vaddr_t pc);
@@ -0,0 +1,41 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __ITRACE_DEF_H__
+#define __ITRACE_DEF_H__
+
+#include <stdint.h>
+
+/* The file format of the binary instruction trace, shared by NEMU and
+ * tools/itrace-dump. The file starts with an ItraceHeader, followed by
+ * records of `rec_size' bytes in little endian:
+ *   pc   : `pc_size' bytes
+ *   inst : 4 bytes, the instruction as fetched (a compressed one is not expanded)
+ *   rd   : `rd_size' bytes, the value of the destination register after
+ *          the instruction, present only if `rd_size' is not zero
+ */
+
+#define ITRACE_MAGIC "NEMUITRC"
+
+typedef struct {
+  char magic[8];
+  char triple[32];  // for the disassembler, e.g. "riscv32-pc-linux-gnu"
+  uint8_t pc_size;
+  uint8_t rd_size;
+  uint16_t rec_size;
+  uint32_t reserved;
+} ItraceHeader;
+
+#endif
@@ -31,7 +31,39 @@ static inline bool in_pmem(paddr_t addr) {
   return addr - CONFIG_MBASE < CONFIG_MSIZE;
 }
 
+#ifdef CONFIG_PMEM_CODE_PAGE
+/* tell the memory that the page of `addr' holds cached or translated instructions */
+void pmem_mark_code(paddr_t addr);
+bool pmem_is_code(paddr_t addr);
+/* one byte for each page of pmem, non-zero if the page is marked */
+uint8_t* pmem_code_pages();
+#endif
+
+/* drop all instructions cached from pmem on this hart, e.g. for fence.i */
+void pmem_code_flush();
+
+/* host address of `len' bytes at `addr' in pmem to be updated in place,
+ * after dropping the instructions cached from them */
+uint8_t* pmem_host_rmw(paddr_t addr, int len);
+
 word_t paddr_read(paddr_t addr, int len);
 void paddr_write(paddr_t addr, int len, word_t data);
 
+#ifdef CONFIG_MTRACE
+/* [mtrace_lo, mtrace_lo + mtrace_span) covers all windows of the memory
+ * tracer, and is empty when it is off, so that an access out of it costs
+ * one branch in paddr_read() and paddr_write().
+ */
+extern paddr_t mtrace_lo, mtrace_span;
+static inline bool mtrace_hit(paddr_t addr) {
+  return addr - mtrace_lo < mtrace_span;
+}
+void mtrace_access(paddr_t addr, int len, bool write, word_t data);
+/* whether the page of `addr' overlaps with a window, so that the accesses
+ * to it should not bypass paddr_read() and paddr_write() */
+bool mtrace_page(paddr_t addr);
+/* whether any window overlaps with pmem */
+bool mtrace_pmem();
+#endif
+
 #endif
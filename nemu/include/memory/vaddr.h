@@ -18,12 +18,85 @@
 
 #include <common.h>
 
+#define PAGE_SHIFT        12
+#define PAGE_SIZE         (1ul << PAGE_SHIFT)
+#define PAGE_MASK         (PAGE_SIZE - 1)
+
+#ifdef CONFIG_SOFT_TLB
+#include <isa.h>
+#include <memory/host.h>
+#include <cpu/cpu.h>
+
+/* A direct-mapped software TLB indexed by guest virtual page. For pages
+ * in pmem, an entry gives the host address directly, so that an access
+ * hitting the TLB costs one compare and one host access. An access of
+ * a page which is not allowed for its type (MEM_TYPE_*), a misaligned
+ * access, or an access to devices goes to the slow path. Tags are filled
+ * for each type separately, after the MMU allows the access.
+ */
+#define SOFT_TLB_INVALID ((vaddr_t)-1)
+
+typedef struct {
+  vaddr_t tag[3];   // page accessible in host memory for each MEM_TYPE_*
+  uintptr_t addend; // host address = addend + guest virtual address
+  vaddr_t io_tag[3]; // page of devices for each MEM_TYPE_*
+  paddr_t io_paddr;  // guest physical address of the page in `io_tag'
+  struct IOMap *io_map; // the only device map in the page, or NULL
+} SoftTLBEntry;
+
+extern HART_LOCAL SoftTLBEntry soft_tlb[CONFIG_SOFT_TLB_SIZE];
+
+static inline SoftTLBEntry* soft_tlb_entry(vaddr_t addr) {
+  return &soft_tlb[(addr >> PAGE_SHIFT) & (CONFIG_SOFT_TLB_SIZE - 1)];
+}
+
+// the low bits of a misaligned address survive the mask,
+// so that it never matches a tag
+static inline bool soft_tlb_hit(SoftTLBEntry *e, vaddr_t addr, int len, int type) {
+  return e->tag[type] == (addr & ~(vaddr_t)(PAGE_MASK ^ (len - 1)));
+}
+
+void soft_tlb_flush();
+word_t vaddr_read_slow(vaddr_t addr, int len, int type);
+void vaddr_write_slow(vaddr_t addr, int len, word_t data);
+
+static inline word_t vaddr_ifetch(vaddr_t addr, int len) {
+  SoftTLBEntry *e = soft_tlb_entry(addr);
+  if (likely(soft_tlb_hit(e, addr, len, MEM_TYPE_IFETCH))) return host_read((void *)(e->addend + addr), len);
+  return vaddr_read_slow(addr, len, MEM_TYPE_IFETCH);
+}
+
+static inline word_t vaddr_read(vaddr_t addr, int len) {
+  SoftTLBEntry *e = soft_tlb_entry(addr);
+  if (likely(soft_tlb_hit(e, addr, len, MEM_TYPE_READ))) return host_read((void *)(e->addend + addr), len);
+  return vaddr_read_slow(addr, len, MEM_TYPE_READ);
+}
+
+static inline void vaddr_write(vaddr_t addr, int len, word_t data) {
+  SoftTLBEntry *e = soft_tlb_entry(addr);
+  if (likely(soft_tlb_hit(e, addr, len, MEM_TYPE_WRITE))) {
+    void *haddr = (void *)(e->addend + addr);
+    IFDEF(CONFIG_SMP, smp_store(haddr, len));
+    host_write(haddr, len, data);
+  } else vaddr_write_slow(addr, len, data);
+}
+#else
 word_t vaddr_ifetch(vaddr_t addr, int len);
 word_t vaddr_read(vaddr_t addr, int len);
 void vaddr_write(vaddr_t addr, int len, word_t data);
+#endif
 
-#define PAGE_SHIFT        12
-#define PAGE_SIZE         (1ul << PAGE_SHIFT)
-#define PAGE_MASK         (PAGE_SIZE - 1)
+/* Whether the decoded or translated instruction at `pc' can be cached,
+ * i.e. it is in pmem and mapped to the same physical address, so that
+ * writes to its physical address drop it.
+ */
+bool vaddr_code_cacheable(vaddr_t pc);
+
+/* The host address of the guest memory [addr, addr + len) for atomic
+ * read-modify-writes, or NULL if it is not in pmem or crosses a page.
+ */
+void* vaddr_host_rmw(vaddr_t addr, int len);
+// the same as vaddr_host_rmw(), but for reading only
+void* vaddr_host_read(vaddr_t addr, int len);
 
 #endif
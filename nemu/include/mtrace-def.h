@@ -0,0 +1,42 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __MTRACE_DEF_H__
+#define __MTRACE_DEF_H__
+
+#include <stdint.h>
+
+/* The file format of the memory access trace, shared by NEMU and
+ * tools/mtrace-dump. The file starts with an MtraceHeader, followed by
+ * records of `rec_size' bytes in little endian:
+ *   pc   : `pc_size' bytes, of the instruction accessing memory
+ *   addr : `addr_size' bytes, the physical address
+ *   data : `data_size' bytes, the data read or written
+ *   len  : 1 byte, the length of the access, with MTRACE_WRITE for a write
+ */
+
+#define MTRACE_MAGIC "NEMUMTRC"
+#define MTRACE_WRITE 0x80
+
+typedef struct {
+  char magic[8];
+  uint8_t pc_size;
+  uint8_t addr_size;
+  uint8_t data_size;
+  uint8_t rec_size;
+  uint32_t reserved;
+} MtraceHeader;
+
+#endif
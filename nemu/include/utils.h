@@ -33,6 +33,12 @@ extern NEMUState nemu_state;
 // ----------- timer -----------
 
 uint64_t get_time();
+/* Time seen by the guest in us, from the host clock, or in virtual time
+ * from the number of guest instructions executed. */
+uint64_t get_guest_time();
+void skip_guest_time(uint64_t us);
+void set_virtual_time(bool on);
+bool is_virtual_time();
 
 // ----------- log -----------
 
@@ -73,5 +79,39 @@ uint64_t get_time();
     log_write(__VA_ARGS__); \
   } while (0)
 
+// ----------- symbol -----------
+
+typedef struct {
+  vaddr_t addr;
+  word_t size;
+  const char *name;
+} Symbol;
+
+void init_elf(const char *file);
+int symbol_nr();
+const Symbol *symbol_get(int idx);
+// Return the index of the function containing `addr', or -1 if there is none.
+int symbol_find(vaddr_t addr);
+
+// ----------- trace -----------
+
+void init_itrace(const char *file, const char *triple);
+void itrace_write(vaddr_t pc, uint32_t inst, word_t rd);
+void itrace_flush();
+
+void init_ftrace();
+void ftrace_call(vaddr_t pc, vaddr_t target);
+void ftrace_ret(vaddr_t pc);
+void ftrace_jump(vaddr_t pc, vaddr_t target);
+void ftrace_statistic();
+int ftrace_backtrace(int *fn, int max);
+
+void init_profiler(const char *file);
+uint64_t profiler_tick(uint64_t n);
+void profiler_check();
+void profiler_dump();
+
+void init_mtrace(const char *file);
+void mtrace_flush();
 
 #endif
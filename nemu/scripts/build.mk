@@ -43,6 +43,9 @@ $(OBJ_DIR)/%.o: %.cc
 # Depencies
 -include $(OBJS:.o=.d)
 
+# Headers generated at build time should be ready before compiling
+$(OBJS): | $(GEN_HEADERS)
+
 # Some convenient rules
 
 .PHONY: app clean
@@ -16,7 +16,9 @@
 #include <cpu/cpu.h>
 #include <cpu/decode.h>
 #include <cpu/difftest.h>
+#include <cpu/block.h>
 #include <locale.h>
+#include <setjmp.h>
 
 /* The assembly code of instructions executed is only output to the screen
  * when the number of instructions executed is less than this value.
@@ -25,34 +27,25 @@
  */
 #define MAX_INST_TO_PRINT 10
 
-CPU_state cpu = {};
-uint64_t g_nr_guest_inst = 0;
+HART_LOCAL CPU_state cpu = {};
+HART_LOCAL uint64_t g_nr_guest_inst = 0;
 static uint64_t g_timer = 0; // unit: us
 static bool g_print_step = false;
+HART_LOCAL volatile bool g_intr_check = false;
+static HART_LOCAL jmp_buf exception_buf;
+static HART_LOCAL word_t exception_no = 0;
 
 void device_update();
 bool polling_wp();
+bool wp_in_use();
+bool log_enable();
 
-static void trace_and_difftest(Decode *_this, vaddr_t dnpc) {
-#ifdef CONFIG_ITRACE_COND
-  if (ITRACE_COND) { log_write("%s\n", _this->logbuf); }
-#endif
-  if (g_print_step) { IFDEF(CONFIG_ITRACE, puts(_this->logbuf)); }
-  IFDEF(CONFIG_DIFFTEST, difftest_step(_this->pc, dnpc));
-  if (polling_wp()) { nemu_state.state = NEMU_STOP; }
-}
-
-static void exec_once(Decode *s, vaddr_t pc) {
-  s->pc = pc;
-  s->snpc = pc;
-  isa_exec_once(s);
-  cpu.pc = s->dnpc;
-#ifdef CONFIG_ITRACE
-  char *p = s->logbuf;
-  p += snprintf(p, sizeof(s->logbuf), FMT_WORD ":", s->pc);
-  int ilen = s->snpc - s->pc;
+#if defined(CONFIG_ITRACE) || defined(CONFIG_IQUEUE)
+// Format an instruction as its PC, bytes and disassembly.
+static void format_inst(char *buf, int size, vaddr_t pc, uint8_t *inst, int ilen) {
+  char *p = buf;
+  p += snprintf(p, size, FMT_WORD ":", pc);
   int i;
-  uint8_t *inst = (uint8_t *)&s->isa.inst.val;
   for (i = ilen - 1; i >= 0; i --) {
     p += snprintf(p, 4, " %02x", inst[i]);
   }
@@ -65,37 +58,265 @@ static void exec_once(Decode *s, vaddr_t pc) {
 
 #ifndef CONFIG_ISA_loongarch32r
   void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
-  disassemble(p, s->logbuf + sizeof(s->logbuf) - p,
-      MUXDEF(CONFIG_ISA_x86, s->snpc, s->pc), (uint8_t *)&s->isa.inst.val, ilen);
+  disassemble(p, buf + size - p, MUXDEF(CONFIG_ISA_x86, pc + ilen, pc), inst, ilen);
 #else
   p[0] = '\0'; // the upstream llvm does not support loongarch32r
 #endif
+}
 #endif
+
+#ifdef CONFIG_IQUEUE
+/* A ring of the last instructions executed, dumped when NEMU aborts.
+ * Recording an instruction costs a few stores, so it can stay on.
+ */
+typedef struct {
+  vaddr_t pc;
+  uint32_t inst;
+  uint32_t ilen; // 0 if the entry is never written
+} IQueueEntry;
+
+static HART_LOCAL IQueueEntry iqueue[CONFIG_IQUEUE_SIZE];
+static HART_LOCAL int iqueue_idx = 0; // the oldest entry, which is written next
+
+static inline void iqueue_push(Decode *s) {
+  IQueueEntry *e = &iqueue[iqueue_idx];
+  e->pc = s->pc;
+  e->inst = s->isa.inst.val;
+  e->ilen = s->snpc - s->pc;
+  iqueue_idx = (iqueue_idx + 1 == CONFIG_IQUEUE_SIZE ? 0 : iqueue_idx + 1);
 }
 
-static void execute(uint64_t n) {
+// Dump the ring, marking the instruction at `pc' where NEMU stops.
+// It is not in the ring if it is stopped before it finishes.
+static void iqueue_dump(vaddr_t pc) {
+  int i;
+  IQueueEntry *newest = &iqueue[(iqueue_idx + CONFIG_IQUEUE_SIZE - 1) % CONFIG_IQUEUE_SIZE];
+  if (newest->ilen == 0) return;
+  printf("The last instructions executed:\n");
+  bool stopped = (newest->ilen != 0 && newest->pc == pc);
+  for (i = 0; i < CONFIG_IQUEUE_SIZE; i ++) {
+    IQueueEntry *e = &iqueue[(iqueue_idx + i) % CONFIG_IQUEUE_SIZE];
+    if (e->ilen == 0) continue;
+    char buf[128];
+    format_inst(buf, sizeof(buf), e->pc, (uint8_t *)&e->inst, e->ilen);
+    printf("%s %s\n", (e == newest && stopped ? "-->" : "   "), buf);
+  }
+  if (!stopped) printf("--> " FMT_WORD ": (not finished)\n", pc);
+}
+#endif
+
+#ifdef CONFIG_ITRACE
+static void itrace_format(Decode *s) {
+  format_inst(s->logbuf, sizeof(s->logbuf), s->pc, (uint8_t *)&s->isa.inst.val, s->snpc - s->pc);
+}
+
+/* Only the instructions which are logged or printed are formatted, since
+ * the disassembler costs much more than executing the instruction.
+ */
+static void itrace(Decode *s) {
+  bool log = ITRACE_COND && log_enable();
+#ifdef CONFIG_ITRACE_BINARY
+  if (log) {
+    itrace_write(s->pc, s->isa.inst.val,
+        MUXDEF(CONFIG_ITRACE_BINARY_RD, cpu.gpr[s->isa.rd], 0));
+  }
+#else
+  if (log || g_print_step) itrace_format(s);
+  if (log) log_write("%s\n", s->logbuf);
+#endif
+  if (g_print_step) {
+    IFDEF(CONFIG_ITRACE_BINARY, itrace_format(s));
+    puts(s->logbuf);
+  }
+}
+#endif
+
+static void trace_and_difftest(Decode *_this, vaddr_t dnpc) {
+  IFDEF(CONFIG_ITRACE, itrace(_this));
+  IFDEF(CONFIG_DIFFTEST, difftest_step(_this->pc, dnpc));
+  if (polling_wp()) { nemu_state.state = NEMU_STOP; }
+}
+
+static void exec_once(Decode *s, vaddr_t pc) {
+  s->pc = pc;
+  s->snpc = pc;
+  isa_exec_once(s);
+  cpu.pc = s->dnpc;
+  IFDEF(CONFIG_IQUEUE, iqueue_push(s));
+}
+
+void longjmp_exception(word_t NO) {
+  exception_no = NO;
+  longjmp(exception_buf, 1);
+}
+
+// The instruction at cpu.pc raised `exception_no'.
+static void take_exception() {
+  // the instructions of the block before it are executed
+  IFDEF(CONFIG_ENGINE_BLOCK, g_nr_guest_inst += block_exception());
+  vaddr_t epc = cpu.pc;
+  cpu.pc = isa_raise_intr(exception_no, epc);
+  IFDEF(CONFIG_DIFFTEST, difftest_step(epc, cpu.pc));
+}
+
+// Take the pending interrupt, if any. Return whether one is taken.
+static bool check_intr() {
+  g_intr_check = false;
+  IFDEF(CONFIG_SMP, smp_check());
+  IFDEF(CONFIG_PROFILER_SIGPROF, profiler_check());
+  word_t intr = isa_query_intr();
+  if (intr == INTR_EMPTY) return false;
+  IFDEF(CONFIG_DIFFTEST, difftest_intr(intr));
+  cpu.pc = isa_raise_intr(intr, cpu.pc);
+  return true;
+}
+
+// Devices are updated on a countdown of instructions in both loops, so
+// that the alarm of virtual time fires at the same instructions.
+#ifdef CONFIG_DEVICE
+// kept across calls, as execute() may split a run
+static HART_LOCAL int64_t device_countdown = 0;
+
+static inline void device_tick(uint64_t nr) {
+  device_countdown -= nr;
+  if (unlikely(device_countdown <= 0)) {
+    device_countdown = CONFIG_DEVICE_UPDATE_INTERVAL;
+    device_update();
+  }
+}
+#endif
+
+static void execute_slow(uint64_t n) {
   Decode s;
-  for (;n > 0; n --) {
+  // Watchpoints and difftest check every instruction, so they are
+  // served by the interpreter, as single-stepping is.
+  IFDEF(CONFIG_ENGINE_BLOCK, bool use_block = !wp_in_use() && !difftest_attached());
+  IFDEF(CONFIG_ENGINE_BLOCK, bool block_start = true);
+  while (n > 0) {
+#ifdef CONFIG_ENGINE_BLOCK
+    // Run a whole block at the start of a basic block if it fits in the
+    // remaining instructions. Blocks are not chained here.
+    if (use_block && block_start && n >= BLOCK_MAX_INSTR) {
+      uint64_t nr = block_exec(cpu.pc, BLOCK_MAX_INSTR);
+      if (nr > 0) {
+        g_nr_guest_inst += nr;
+        n -= nr;
+        if (nemu_state.state != NEMU_RUNNING) break;
+        IFDEF(CONFIG_DEVICE, device_tick(nr));
+        if (g_intr_check) check_intr();
+        continue;
+      }
+    }
+#endif
     exec_once(&s, cpu.pc);
+    IFDEF(CONFIG_ENGINE_BLOCK, block_start = (s.dnpc != s.snpc));
     g_nr_guest_inst ++;
+    n --;
     trace_and_difftest(&s, cpu.pc);
     if (nemu_state.state != NEMU_RUNNING) break;
-    IFDEF(CONFIG_DEVICE, device_update());
+    IFDEF(CONFIG_DEVICE, device_tick(1));
+    if (g_intr_check && check_intr()) { IFDEF(CONFIG_ENGINE_BLOCK, block_start = true); }
+  }
+}
+
+// Nothing but the flag of interrupts is checked after each instruction.
+static void execute_fast(uint64_t n) {
+  Decode s;
+  IFDEF(CONFIG_ENGINE_BLOCK, bool block_start = true);
+  while (n > 0) {
+    uint64_t nr = 0;
+#ifdef CONFIG_ENGINE_BLOCK
+    // chained blocks run until the next device update
+    uint64_t limit = n;
+    IFDEF(CONFIG_DEVICE, if ((uint64_t)device_countdown < limit) limit = (device_countdown < BLOCK_MAX_INSTR ? BLOCK_MAX_INSTR : device_countdown));
+    if (block_start && n >= BLOCK_MAX_INSTR) nr = block_exec(cpu.pc, limit);
+#endif
+    if (nr == 0) {
+      exec_once(&s, cpu.pc);
+      IFDEF(CONFIG_ENGINE_BLOCK, block_start = (s.dnpc != s.snpc));
+      nr = 1;
+    }
+    g_nr_guest_inst += nr;
+    n -= nr;
+    if (unlikely(nemu_state.state != NEMU_RUNNING)) break;
+    IFDEF(CONFIG_DEVICE, device_tick(nr));
+    if (unlikely(g_intr_check) && check_intr()) { IFDEF(CONFIG_ENGINE_BLOCK, block_start = true); }
+  }
+}
+
+// The slow loop is only needed when some debugging feature is active.
+// Only the instructions in the window of the instruction tracer are
+// traced, so the run is split at the window, and the rest runs fast.
+static void execute_run(uint64_t n) {
+  if (g_print_step || wp_in_use() || difftest_attached()) {
+    execute_slow(n);
+    return;
+  }
+#ifdef CONFIG_ITRACE
+  uint64_t now = g_nr_guest_inst;
+  if (now < CONFIG_TRACE_START) {
+    if (n > CONFIG_TRACE_START - now) n = CONFIG_TRACE_START - now;
+  } else if (now <= CONFIG_TRACE_END) {
+    execute_slow(n < CONFIG_TRACE_END + 1 - now ? n : CONFIG_TRACE_END + 1 - now);
+    return;
+  }
+#endif
+  execute_fast(n);
+}
+
+// An exception goes back here, and the loop starts over after the trap.
+// The profiler splits the instructions into runs between its samples.
+static void execute(uint64_t n) {
+  uint64_t start = g_nr_guest_inst;
+  if (setjmp(exception_buf) != 0) {
+    take_exception();
+    if (nemu_state.state != NEMU_RUNNING) return;
   }
+  uint64_t remain;
+  while ((remain = n - (g_nr_guest_inst - start)) > 0) {
+    IFDEF(CONFIG_PROFILER_INST, remain = profiler_tick(remain));
+    execute_run(remain);
+    if (nemu_state.state != NEMU_RUNNING) return;
+  }
+}
+
+#ifdef CONFIG_SMP
+void cpu_exec_hart(uint64_t n) {
+  execute(n);
 }
+#endif
 
 static void statistic() {
   IFNDEF(CONFIG_TARGET_AM, setlocale(LC_NUMERIC, ""));
 #define NUMBERIC_FMT MUXDEF(CONFIG_TARGET_AM, "%", "%'") PRIu64
   Log("host time spent = " NUMBERIC_FMT " us", g_timer);
-  Log("total guest instructions = " NUMBERIC_FMT, g_nr_guest_inst);
-  if (g_timer > 0) Log("simulation frequency = " NUMBERIC_FMT " inst/s", g_nr_guest_inst * 1000000 / g_timer);
+  uint64_t nr_inst = MUXDEF(CONFIG_SMP, smp_nr_guest_inst(), g_nr_guest_inst);
+  Log("total guest instructions = " NUMBERIC_FMT, nr_inst);
+  if (g_timer > 0) Log("simulation frequency = " NUMBERIC_FMT " inst/s", nr_inst * 1000000 / g_timer);
   else Log("Finish running in less than 1 us and can not calculate the simulation frequency");
+#ifdef CONFIG_DECODE_CACHE
+  IFNDEF(CONFIG_SMP, extern uint64_t g_nr_dcache_hit);
+  IFNDEF(CONFIG_SMP, extern uint64_t g_nr_dcache_miss);
+  uint64_t nr_hit = MUXDEF(CONFIG_SMP, smp_nr_dcache_hit(), g_nr_dcache_hit);
+  uint64_t nr_miss = MUXDEF(CONFIG_SMP, smp_nr_dcache_miss(), g_nr_dcache_miss);
+  uint64_t nr_lookup = nr_hit + nr_miss;
+  Log("decode cache hit = " NUMBERIC_FMT ", miss = " NUMBERIC_FMT ", hit rate = %.2f%%",
+      nr_hit, nr_miss, nr_lookup > 0 ? nr_hit * 100.0 / nr_lookup : 0.0);
+#endif
+  IFDEF(CONFIG_ENGINE_BLOCK, block_statistic());
+  isa_mmu_statistic();
+  IFDEF(CONFIG_FTRACE_PROFILE, ftrace_statistic());
+  IFDEF(CONFIG_PROFILER, profiler_dump());
 }
 
 void assert_fail_msg() {
+  IFDEF(CONFIG_ITRACE_BINARY, itrace_flush());
+  IFDEF(CONFIG_MTRACE, mtrace_flush());
+  IFDEF(CONFIG_IQUEUE, iqueue_dump(cpu.pc));
   isa_reg_display();
   statistic();
+  // assert() aborts without flushing stdout
+  fflush(stdout);
 }
 
 /* Simulate how the CPU works. */
@@ -110,10 +331,12 @@ void cpu_exec(uint64_t n) {
 
   uint64_t timer_start = get_time();
 
-  execute(n);
+  MUXDEF(CONFIG_SMP, smp_exec(n), execute(n));
 
   uint64_t timer_end = get_time();
   g_timer += timer_end - timer_start;
+  IFDEF(CONFIG_ITRACE_BINARY, itrace_flush());
+  IFDEF(CONFIG_MTRACE, mtrace_flush());
 
   switch (nemu_state.state) {
     case NEMU_RUNNING: nemu_state.state = NEMU_STOP; break;
@@ -124,6 +347,7 @@ void cpu_exec(uint64_t n) {
            (nemu_state.halt_ret == 0 ? ANSI_FMT("HIT GOOD TRAP", ANSI_FG_GREEN) :
             ANSI_FMT("HIT BAD TRAP", ANSI_FG_RED))),
           nemu_state.halt_pc);
+      IFDEF(CONFIG_IQUEUE, if (nemu_state.state == NEMU_ABORT) iqueue_dump(nemu_state.halt_pc));
       // fall through
     case NEMU_QUIT: statistic();
   }
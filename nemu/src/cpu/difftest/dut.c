@@ -30,6 +30,12 @@ void (*ref_difftest_raise_intr)(uint64_t NO) = NULL;
 
 static bool is_skip_ref = false;
 static int skip_dut_nr_inst = 0;
+// whether a reference is loaded by --diff
+static bool is_attached = false;
+
+bool difftest_attached() {
+  return is_attached;
+}
 
 // this is used to let ref skip instructions which
 // can not produce consistent behavior with NEMU
@@ -60,7 +66,10 @@ void difftest_skip_dut(int nr_ref, int nr_dut) {
 }
 
 void init_difftest(char *ref_so_file, long img_size, int port) {
-  assert(ref_so_file != NULL);
+  if (ref_so_file == NULL) {
+    Log("Differential testing: %s, since no reference is given by --diff", ANSI_FMT("OFF", ANSI_FG_RED));
+    return;
+  }
 
   void *handle;
   handle = dlopen(ref_so_file, RTLD_LAZY);
@@ -89,6 +98,7 @@ void init_difftest(char *ref_so_file, long img_size, int port) {
   ref_difftest_init(port);
   ref_difftest_memcpy(RESET_VECTOR, guest_to_host(RESET_VECTOR), img_size, DIFFTEST_TO_REF);
   ref_difftest_regcpy(&cpu, DIFFTEST_TO_REF);
+  is_attached = true;
 }
 
 static void checkregs(CPU_state *ref, vaddr_t pc) {
@@ -102,6 +112,8 @@ static void checkregs(CPU_state *ref, vaddr_t pc) {
 void difftest_step(vaddr_t pc, vaddr_t npc) {
   CPU_state ref_r;
 
+  if (!is_attached) return;
+
   if (skip_dut_nr_inst > 0) {
     ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
     if (ref_r.pc == npc) {
@@ -127,6 +139,12 @@ void difftest_step(vaddr_t pc, vaddr_t npc) {
 
   checkregs(&ref_r, pc);
 }
+
+// the DUT takes the interrupt `NO' before the next instruction
+void difftest_intr(word_t NO) {
+  if (!is_attached) return;
+  ref_difftest_raise_intr(NO);
+}
 #else
 void init_difftest(char *ref_so_file, long img_size, int port) { }
 #endif
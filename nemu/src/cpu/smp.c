@@ -0,0 +1,241 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <memory/vaddr.h>
+
+#ifdef CONFIG_SMP
+#include <pthread.h>
+#include <signal.h>
+
+/* Each hart runs in its own host thread over the shared pmem, and hart 0
+ * runs in the main thread, which also runs the monitor and updates the
+ * devices. The state of a hart and what is cached from it are declared
+ * with HART_LOCAL, so that the code of a single hart is used as is.
+ * With CONFIG_SMP_QUANTUM > 0, the harts take turns to run that number
+ * of instructions each in the order of their IDs, so that a run is
+ * deterministic.
+ */
+
+__thread int g_hart_id = 0;
+extern __thread uint64_t g_nr_guest_inst;
+IFDEF(CONFIG_DECODE_CACHE, extern __thread uint64_t g_nr_dcache_hit);
+IFDEF(CONFIG_DECODE_CACHE, extern __thread uint64_t g_nr_dcache_miss);
+
+static pthread_t thread[CONFIG_NR_HART];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t nr_run = 0;  // number of runs started
+static uint64_t budget = 0;  // instructions for each hart in the current run
+static int nr_busy = 0;      // harts other than hart 0 still in the current run
+static uint64_t *nr_guest_inst[CONFIG_NR_HART]; // g_nr_guest_inst of each hart
+static volatile bool *intr_check[CONFIG_NR_HART]; // g_intr_check of each hart
+IFDEF(CONFIG_DECODE_CACHE, static uint64_t *nr_dcache_hit[CONFIG_NR_HART]);
+IFDEF(CONFIG_DECODE_CACHE, static uint64_t *nr_dcache_miss[CONFIG_NR_HART]);
+
+#if CONFIG_SMP_QUANTUM > 0
+static pthread_cond_t turn_cond = PTHREAD_COND_INITIALIZER;
+static int turn = 0; // the hart allowed to run
+
+static void run(int id, uint64_t n) {
+  while (n > 0) {
+    pthread_mutex_lock(&lock);
+    while (turn != id) pthread_cond_wait(&turn_cond, &lock);
+    pthread_mutex_unlock(&lock);
+
+    // once some hart stops the run, the others only pass the turn on;
+    // the state is read before passing the turn, since it may change
+    // as soon as the next hart runs, and a hart leaving a pass early
+    // would keep the turn from its successor
+    uint64_t q = (n < CONFIG_SMP_QUANTUM ? n : CONFIG_SMP_QUANTUM);
+    if (nemu_state.state == NEMU_RUNNING) cpu_exec_hart(q);
+    bool stop = (nemu_state.state != NEMU_RUNNING);
+    n -= q;
+
+    pthread_mutex_lock(&lock);
+    turn = (id + 1) % CONFIG_NR_HART;
+    pthread_cond_broadcast(&turn_cond);
+    pthread_mutex_unlock(&lock);
+    if (stop) break;
+  }
+}
+#else
+static void run(int id, uint64_t n) {
+  cpu_exec_hart(n);
+}
+#endif
+
+static void hart_init(int id) {
+  g_hart_id = id;
+  nr_guest_inst[id] = &g_nr_guest_inst;
+  intr_check[id] = &g_intr_check;
+  IFDEF(CONFIG_DECODE_CACHE, nr_dcache_hit[id] = &g_nr_dcache_hit);
+  IFDEF(CONFIG_DECODE_CACHE, nr_dcache_miss[id] = &g_nr_dcache_miss);
+  IFDEF(CONFIG_SOFT_TLB, soft_tlb_flush());
+  isa_hart_init(id);
+}
+
+static void done() {
+  pthread_mutex_lock(&lock);
+  if (-- nr_busy == 0) pthread_cond_signal(&done_cond);
+  pthread_mutex_unlock(&lock);
+}
+
+static void wait_done() {
+  pthread_mutex_lock(&lock);
+  while (nr_busy > 0) pthread_cond_wait(&done_cond, &lock);
+  pthread_mutex_unlock(&lock);
+}
+
+static void* hart_thread(void *arg) {
+  int id = (intptr_t)arg;
+  // the alarm raising the interrupts of devices goes to hart 0
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGVTALRM);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+  hart_init(id);
+  done();
+  uint64_t last_run = 0;
+  while (true) {
+    pthread_mutex_lock(&lock);
+    while (nr_run == last_run) pthread_cond_wait(&start_cond, &lock);
+    last_run = nr_run;
+    uint64_t n = budget;
+    pthread_mutex_unlock(&lock);
+
+    run(id, n);
+    done();
+  }
+  return NULL;
+}
+
+void smp_exec(uint64_t n) {
+  pthread_mutex_lock(&lock);
+  budget = n;
+  nr_busy = CONFIG_NR_HART - 1;
+#if CONFIG_SMP_QUANTUM > 0
+  turn = 0;
+#endif
+  nr_run ++;
+  pthread_cond_broadcast(&start_cond);
+  pthread_mutex_unlock(&lock);
+
+  run(0, n);
+  wait_done();
+}
+
+uint64_t smp_nr_guest_inst() {
+  uint64_t sum = 0;
+  int i;
+  for (i = 0; i < CONFIG_NR_HART; i ++) sum += *nr_guest_inst[i];
+  return sum;
+}
+
+#ifdef CONFIG_DECODE_CACHE
+uint64_t smp_nr_dcache_hit() {
+  uint64_t sum = 0;
+  int i;
+  for (i = 0; i < CONFIG_NR_HART; i ++) sum += *nr_dcache_hit[i];
+  return sum;
+}
+
+uint64_t smp_nr_dcache_miss() {
+  uint64_t sum = 0;
+  int i;
+  for (i = 0; i < CONFIG_NR_HART; i ++) sum += *nr_dcache_miss[i];
+  return sum;
+}
+#endif
+
+#ifdef CONFIG_SOFT_TLB
+/* The soft TLBs of all harts are flushed by bumping the generation. The
+ * other harts are told to look at it with their flags of interrupts, so
+ * that they flush before their next instruction.
+ */
+static uint64_t soft_tlb_gen = 0;
+static HART_LOCAL uint64_t soft_tlb_seen = 0;
+
+void smp_soft_tlb_flush() {
+  soft_tlb_seen = __atomic_add_fetch(&soft_tlb_gen, 1, __ATOMIC_SEQ_CST);
+  soft_tlb_flush();
+  int i;
+  for (i = 0; i < CONFIG_NR_HART; i ++) {
+    if (i != g_hart_id) *intr_check[i] = true;
+  }
+}
+#endif
+
+void smp_check() {
+#ifdef CONFIG_SOFT_TLB
+  // order the clearing of g_intr_check before the load of the generation,
+  // so that a flush requested meanwhile is not missed
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  uint64_t gen = __atomic_load_n(&soft_tlb_gen, __ATOMIC_RELAXED);
+  if (gen != soft_tlb_seen) {
+    soft_tlb_seen = gen;
+    soft_tlb_flush();
+  }
+#endif
+}
+
+/* Reservations of LR. Each hart reserves the host address of a word in
+ * pmem, and a store of another hart to the word drops the reservation
+ * before it writes, so that its SC fails. As a store may have checked
+ * the reservations just before an LR, an SC also compares the value
+ * loaded by LR, which catches the store written after the LR.
+ */
+static void * volatile reservation[CONFIG_NR_HART];
+volatile int g_nr_reservation = 0;
+
+void smp_reserve(void *haddr) {
+  void *old = __atomic_exchange_n(&reservation[g_hart_id], haddr, __ATOMIC_SEQ_CST);
+  int diff = (haddr != NULL) - (old != NULL);
+  if (diff != 0) __atomic_add_fetch(&g_nr_reservation, diff, __ATOMIC_SEQ_CST);
+}
+
+bool smp_unreserve() {
+  void *old = __atomic_exchange_n(&reservation[g_hart_id], NULL, __ATOMIC_SEQ_CST);
+  if (old != NULL) __atomic_sub_fetch(&g_nr_reservation, 1, __ATOMIC_SEQ_CST);
+  return old != NULL;
+}
+
+void smp_drop_reservation(void *haddr, int len) {
+  uint8_t *p = haddr;
+  int i;
+  for (i = 0; i < CONFIG_NR_HART; i ++) {
+    void *r = reservation[i];
+    if (i == g_hart_id || r == NULL) continue;
+    if ((uint8_t *)r < p + len && p < (uint8_t *)r + sizeof(word_t) &&
+        __atomic_compare_exchange_n(&reservation[i], &r, NULL, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      __atomic_sub_fetch(&g_nr_reservation, 1, __ATOMIC_SEQ_CST);
+    }
+  }
+}
+
+void init_smp() {
+  hart_init(0);
+  nr_busy = CONFIG_NR_HART - 1;
+  int i;
+  for (i = 1; i < CONFIG_NR_HART; i ++) {
+    int ret = pthread_create(&thread[i], NULL, hart_thread, (void *)(intptr_t)i);
+    Assert(ret == 0, "Can not create the thread of hart %d", i);
+  }
+  wait_done();
+  Log("SMP: %d harts, quantum = %d", CONFIG_NR_HART, CONFIG_SMP_QUANTUM);
+}
+#endif
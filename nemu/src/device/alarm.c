@@ -28,14 +28,20 @@ void add_alarm_handle(alarm_handler_t h) {
   handler[idx ++] = h;
 }
 
-static void alarm_sig_handler(int signum) {
+void alarm_fire() {
   int i;
   for (i = 0; i < idx; i ++) {
     handler[i]();
   }
 }
 
+static void alarm_sig_handler(int signum) {
+  alarm_fire();
+}
+
 void init_alarm() {
+  if (is_virtual_time()) return;
+
   struct sigaction s;
   memset(&s, 0, sizeof(s));
   s.sa_handler = alarm_sig_handler;
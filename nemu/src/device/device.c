@@ -16,6 +16,8 @@
 #include <common.h>
 #include <utils.h>
 #include <device/alarm.h>
+#include <cpu/cpu.h>
+#include <device/map.h>
 #ifndef CONFIG_TARGET_AM
 #include <SDL2/SDL.h>
 #endif
@@ -35,12 +37,16 @@ void vga_update_screen();
 
 void device_update() {
   static uint64_t last = 0;
-  uint64_t now = get_time();
+  // devices are updated by hart 0, which runs in the main thread as SDL requires
+  if (hart_id() != 0) return;
+  uint64_t now = get_guest_time();
   if (now - last < 1000000 / TIMER_HZ) {
     return;
   }
   last = now;
+  IFNDEF(CONFIG_TARGET_AM, if (is_virtual_time()) alarm_fire());
 
+  IFDEF(CONFIG_SMP, map_lock());
   IFDEF(CONFIG_HAS_VGA, vga_update_screen());
 
 #ifndef CONFIG_TARGET_AM
@@ -64,6 +70,7 @@ void device_update() {
     }
   }
 #endif
+  IFDEF(CONFIG_SMP, map_unlock());
 }
 
 void sdl_clear_event_queue() {
@@ -86,4 +93,5 @@ void init_device() {
   IFDEF(CONFIG_HAS_SDCARD, init_sdcard());
 
   IFNDEF(CONFIG_TARGET_AM, init_alarm());
+  if (is_virtual_time()) Log("Virtual time: %d guest instructions per us", CONFIG_VIRTUAL_TIME_MIPS);
 }
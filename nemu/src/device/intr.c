@@ -14,6 +14,13 @@
 ***************************************************************************************/
 
 #include <isa.h>
+#include <cpu/cpu.h>
 
-void dev_raise_intr() {
+/* Make the interrupt `irq' pending on hart 0, which runs the devices. It
+ * may be called in the handler of the alarm signal, so the hart only
+ * takes it at the next block boundary.
+ */
+void dev_raise_intr(int irq) {
+  isa_dev_raise_intr(irq);
+  g_intr_check = true;
 }
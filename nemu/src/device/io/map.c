@@ -17,6 +17,15 @@
 #include <memory/host.h>
 #include <memory/vaddr.h>
 #include <device/map.h>
+#include <cpu/cpu.h>
+
+#ifdef CONFIG_SMP
+#include <pthread.h>
+// device accesses from different harts are serialized
+static pthread_mutex_t io_lock = PTHREAD_MUTEX_INITIALIZER;
+void map_lock() { pthread_mutex_lock(&io_lock); }
+void map_unlock() { pthread_mutex_unlock(&io_lock); }
+#endif
 
 #define IO_SPACE_MAX (2 * 1024 * 1024)
 
@@ -56,8 +65,10 @@ word_t map_read(paddr_t addr, int len, IOMap *map) {
   assert(len >= 1 && len <= 8);
   check_bound(map, addr);
   paddr_t offset = addr - map->low;
+  IFDEF(CONFIG_SMP, map_lock());
   invoke_callback(map->callback, offset, len, false); // prepare data to read
   word_t ret = host_read(map->space + offset, len);
+  IFDEF(CONFIG_SMP, map_unlock());
   return ret;
 }
 
@@ -65,6 +76,8 @@ void map_write(paddr_t addr, int len, word_t data, IOMap *map) {
   assert(len >= 1 && len <= 8);
   check_bound(map, addr);
   paddr_t offset = addr - map->low;
+  IFDEF(CONFIG_SMP, map_lock());
   host_write(map->space + offset, len, data);
   invoke_callback(map->callback, offset, len, true);
+  IFDEF(CONFIG_SMP, map_unlock());
 }
@@ -15,15 +15,69 @@
 
 #include <device/map.h>
 #include <memory/paddr.h>
+#include <memory/vaddr.h>
 
-#define NR_MAP 16
+#define NR_MAP 128
 
 static IOMap maps[NR_MAP] = {};
 static int nr_map = 0;
 
+/* A two-level table from physical page to IOMap, built by add_mmio_map().
+ * A page shared by several maps, or partly covered by a map, points
+ * to a sub-page table with one entry for each byte of the page, and is
+ * tagged with MMIO_SUBPAGE in the low bit. Only the lower 4GB of the
+ * physical address space can hold mmio maps.
+ */
+#define MMIO_DIR_SHIFT 10
+#define MMIO_NR_DIR    (1u << (32 - PAGE_SHIFT - MMIO_DIR_SHIFT))
+#define MMIO_SUBPAGE   1
+
+static uintptr_t *mmio_dir[MMIO_NR_DIR] = {};
+
+static inline uintptr_t* mmio_dir_of(paddr_t addr) {
+  if ((uint64_t)addr >> 32) return NULL;
+  return mmio_dir[(uint32_t)addr >> (PAGE_SHIFT + MMIO_DIR_SHIFT)];
+}
+
+static inline uintptr_t mmio_page_entry(paddr_t addr) {
+  uintptr_t *dir = mmio_dir_of(addr);
+  return (dir == NULL ? 0 : dir[(addr >> PAGE_SHIFT) & BITMASK(MMIO_DIR_SHIFT)]);
+}
+
 static IOMap* fetch_mmio_map(paddr_t addr) {
-  int mapid = find_mapid_by_addr(maps, nr_map, addr);
-  return (mapid == -1 ? NULL : &maps[mapid]);
+  uintptr_t e = mmio_page_entry(addr);
+  if (unlikely(e & MMIO_SUBPAGE)) e = (uintptr_t)((IOMap **)(e ^ MMIO_SUBPAGE))[addr & PAGE_MASK];
+  if (e != 0) difftest_skip_ref();
+  return (IOMap *)e;
+}
+
+static void mmio_map_page(IOMap *map, paddr_t page) {
+  uintptr_t **dir = &mmio_dir[(uint32_t)page >> (PAGE_SHIFT + MMIO_DIR_SHIFT)];
+  if (*dir == NULL) {
+    *dir = calloc(1u << MMIO_DIR_SHIFT, sizeof(**dir));
+    assert(*dir);
+  }
+  uintptr_t *e = &(*dir)[(page >> PAGE_SHIFT) & BITMASK(MMIO_DIR_SHIFT)];
+  paddr_t left = (map->low > page ? map->low : page);
+  paddr_t right = (map->high < page + PAGE_MASK ? map->high : page + PAGE_MASK);
+  if (left == page && right == page + PAGE_MASK) {
+    // maps never overlap, so the page is empty before
+    *e = (uintptr_t)map;
+    return;
+  }
+  if (*e == 0) {
+    IOMap **sub = calloc(PAGE_SIZE, sizeof(*sub));
+    assert(sub);
+    *e = (uintptr_t)sub | MMIO_SUBPAGE;
+  }
+  IOMap **sub = (IOMap **)(*e ^ MMIO_SUBPAGE);
+  paddr_t i;
+  for (i = left & PAGE_MASK; i <= (right & PAGE_MASK); i ++) sub[i] = map;
+}
+
+IOMap* mmio_map_of_page(paddr_t addr) {
+  uintptr_t e = mmio_page_entry(addr);
+  return (e & MMIO_SUBPAGE ? NULL : (IOMap *)e);
 }
 
 static void report_mmio_overlap(const char *name1, paddr_t l1, paddr_t r1,
@@ -45,8 +99,17 @@ void add_mmio_map(const char *name, paddr_t addr, void *space, uint32_t len, io_
     }
   }
 
+  if ((uint64_t)right >> 32) {
+    panic("MMIO region %s@[" FMT_PADDR ", " FMT_PADDR "] is out of the lower 4GB",
+        name, left, right);
+  }
+
   maps[nr_map] = (IOMap){ .name = name, .low = addr, .high = addr + len - 1,
     .space = space, .callback = callback };
+  int i, nr_page = (right >> PAGE_SHIFT) - (left >> PAGE_SHIFT) + 1;
+  for (i = 0; i < nr_page; i ++) {
+    mmio_map_page(&maps[nr_map], (left & ~PAGE_MASK) + i * PAGE_SIZE);
+  }
   Log("Add mmio map '%s' at [" FMT_PADDR ", " FMT_PADDR "]",
       maps[nr_map].name, maps[nr_map].low, maps[nr_map].high);
 
@@ -13,6 +13,7 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
+#include <isa.h>
 #include <device/map.h>
 #include <utils.h>
 
@@ -68,6 +69,8 @@ void send_key(uint8_t scancode, bool is_keydown) {
   if (nemu_state.state == NEMU_RUNNING && keymap[scancode] != NEMU_KEY_NONE) {
     uint32_t am_scancode = keymap[scancode] | (is_keydown ? KEYDOWN_MASK : 0);
     key_enqueue(am_scancode);
+    extern void dev_raise_intr(int irq);
+    dev_raise_intr(DEV_IRQ_EXTERNAL);
   }
 }
 #else // !CONFIG_TARGET_AM
@@ -13,16 +13,63 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
+#include <isa.h>
+#include <cpu/block.h>
 #include <device/map.h>
 #include <device/alarm.h>
 #include <utils.h>
+#include <unistd.h>
 
 static uint32_t *rtc_port_base = NULL;
 
+#ifdef CONFIG_RTC_IDLE
+/* A guest waiting for some time, e.g. for the next frame, polls the RTC
+ * in a loop doing nothing else. Such a loop is told from its decoded
+ * code by isa_rtc_poll_loop(). In virtual time or in batch mode, the time
+ * it waits for is skipped, so that the guest time runs ahead. Otherwise,
+ * the host thread sleeps instead of spinning, a bounded time so that the
+ * devices are still updated. If the deadline is not known, the step
+ * doubles while the guest keeps polling, so that a long wait takes few
+ * polls, and it is bounded, so that the guest does not wait much longer.
+ */
+#define RTC_IDLE_GAP 64 // maximum instructions between two polls of a loop
+#define RTC_IDLE_STEP_MAX 1024 // us
+#define RTC_IDLE_SLEEP_MAX 10000 // us
+
+extern HART_LOCAL uint64_t g_nr_guest_inst;
+
+static void rtc_idle(uint32_t offset) {
+  extern bool sdb_is_batch_mode();
+  static vaddr_t last_pc = 0;
+  static uint64_t last_inst = 0, step = 1;
+  vaddr_t pc = MUXDEF(CONFIG_ENGINE_BLOCK, block_pc(), cpu.pc);
+  uint64_t inst = g_nr_guest_inst + MUXDEF(CONFIG_ENGINE_BLOCK, block_nr_inst(), 0);
+  bool has_deadline = false;
+  word_t deadline = 0;
+  if (!isa_rtc_poll_loop(pc, offset, 8, &has_deadline, &deadline)) return;
+  if (pc != last_pc || inst - last_inst > RTC_IDLE_GAP) step = 1;
+  last_pc = pc;
+  last_inst = inst;
+
+  uint64_t now = get_guest_time(), us;
+  if (has_deadline) {
+    uint64_t until = (now & ~(uint64_t)UINT32_MAX) | (uint32_t)deadline;
+    us = (until > now ? until - now : 0);
+  } else {
+    us = step;
+    if (step < RTC_IDLE_STEP_MAX) step *= 2;
+  }
+  if (us == 0) return;
+  if (is_virtual_time() || sdb_is_batch_mode()) skip_guest_time(us);
+  else usleep(us < RTC_IDLE_SLEEP_MAX ? us : RTC_IDLE_SLEEP_MAX);
+}
+#endif
+
 static void rtc_io_handler(uint32_t offset, int len, bool is_write) {
   assert(offset == 0 || offset == 4);
   if (!is_write && offset == 4) {
-    uint64_t us = get_time();
+    IFDEF(CONFIG_RTC_IDLE, rtc_idle(offset));
+    uint64_t us = get_guest_time();
     rtc_port_base[0] = (uint32_t)us;
     rtc_port_base[1] = us >> 32;
   }
@@ -31,8 +78,8 @@ static void rtc_io_handler(uint32_t offset, int len, bool is_write) {
 #ifndef CONFIG_TARGET_AM
 static void timer_intr() {
   if (nemu_state.state == NEMU_RUNNING) {
-    extern void dev_raise_intr();
-    dev_raise_intr();
+    extern void dev_raise_intr(int irq);
+    dev_raise_intr(DEV_IRQ_TIMER);
   }
 }
 #endif
@@ -0,0 +1,752 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <isa-all-instr.h>
+#include <cpu/cpu.h>
+#include <cpu/block.h>
+#include <cpu/decode.h>
+#include <memory/paddr.h>
+#include <memory/vaddr.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include "x86.h"
+
+#ifndef __x86_64__
+#error "the binary translator only supports x86-64 hosts"
+#endif
+
+/* Host registers in translated code:
+ *   R15         - &cpu
+ *   R14         - host address of the guest physical memory
+ *   R13         - number of guest instructions executed
+ *   RAX/RCX/RDX - scratch
+ *   the others  - guest registers cached within a block
+ *   [RSP]       - the chaining limit of REG_NINST
+ * Every block starts and ends with all guest registers in `cpu'.
+ */
+#define REG_CPU   R15
+#define REG_PMEM  R14
+#define REG_NINST R13
+
+#define GPR_OFF(i) ((int)offsetof(CPU_state, gpr[i]))
+#define PC_OFF     ((int)offsetof(CPU_state, pc))
+
+#define CODE_CACHE_SIZE (CONFIG_DBT_CODE_CACHE_SIZE * 1024 * 1024)
+#define BLOCK_CODE_MAX (32 * 1024) // host code of a block never exceeds this
+#define NR_BLOCK 65536
+#define NR_HELPER_DECODE 65536
+#define BLOCK_TABLE_SIZE 65536
+#define NR_PAGE (CONFIG_MSIZE >> PAGE_SHIFT)
+#define NR_EXIT (NR_BLOCK * 2) // a block has at most 2 exits
+#define NR_LINK (NR_BLOCK * 4)
+#define NR_JALR_CACHE 4
+#define PC_INVALID 1
+
+static_assert(CONFIG_MSIZE <= 0x7fffffff, "the bound check of pmem uses a signed 32-bit immediate");
+
+/* An exit of a block to a target known at translation, or the exit of
+ * jalr which compares the target with those seen recently, can jump to
+ * the following block directly. Otherwise it goes to the tail, which
+ * returns the exit from dbt_enter(), so that it is chained to the block
+ * at cpu.pc by patching the jump. The links to a block are recorded in
+ * the block, and they are unpatched when the block is dropped.
+ */
+typedef struct {
+  uint8_t *jump[NR_JALR_CACHE]; // rel32 of the jumps to be chained
+  uint8_t *cmp[NR_JALR_CACHE];  // for jalr, imm32 of the comparisons with the target
+  uint8_t *tail;
+  int nr, victim;
+} Exit;
+
+typedef struct Link {
+  Exit *exit;
+  int i;
+  struct Link *next;
+} Link;
+
+typedef struct Block {
+  vaddr_t pc, end; // guest instructions in [pc, end)
+  uint8_t *code;
+  struct Block *next; // the next block in the same page
+  Link *in; // the links to this block
+} Block;
+
+// the number of guest instructions executed, and the exit to be chained
+typedef struct { uint64_t n; Exit *exit; } DBTResult;
+
+uint8_t *x86_code = NULL;
+static uint8_t *code_cache = NULL, *code_start = NULL;
+static DBTResult (*dbt_enter)(uint8_t *code, uint64_t limit) = NULL;
+static uint8_t *dbt_leave = NULL, *dbt_leave_exit = NULL;
+static uint8_t *code_pages = NULL;
+
+static Block blocks[NR_BLOCK];
+static int nr_block = 0;
+// instructions executed by calling their execution helpers
+static Decode helper_decode[NR_HELPER_DECODE];
+static int nr_helper_decode = 0;
+static Block *block_table[BLOCK_TABLE_SIZE] = {};
+static uint8_t hotness[BLOCK_TABLE_SIZE] = {};
+static Block *page_blocks[NR_PAGE] = {};
+static bool stale = false; // some blocks are dropped by block_invalidate()
+static Exit exits[NR_EXIT];
+static int nr_exit = 0;
+static Link links[NR_LINK];
+static int nr_link = 0;
+
+uint64_t g_nr_block_inst = 0;
+static bool running = false; // in dbt_enter()
+// the instructions executed before the one calling a helper or a stub,
+// which may raise an exception, see block_exception()
+static uint64_t nr_before_call = 0;
+static uint64_t nr_translate = 0, nr_flush = 0, nr_exec = 0, nr_chain = 0;
+
+static inline int table_idx(vaddr_t pc) { return (pc >> 2) & (BLOCK_TABLE_SIZE - 1); }
+
+// --- register allocation ---
+
+typedef struct {
+  int8_t host[32];  // host register caching the guest register, or -1
+  int8_t guest[16]; // guest register cached by the host register, or -1
+  uint32_t dirty;   // guest registers newer than those in `cpu'
+} RegState;
+
+static RegState regs;
+static uint32_t locked; // host registers used by the current instruction
+static uint32_t lru[16], lru_clock;
+
+// Callee-saved registers come first, so that fewer
+// registers are saved around the calls to helpers.
+static const int reg_pool[] = { RBX, RBP, R12, RSI, RDI, R8, R9, R10, R11 };
+#define CALLER_SAVED(h) ((h) != RBX && (h) != RBP && (h) != R12)
+
+static void regs_reset() {
+  memset(regs.host, -1, sizeof(regs.host));
+  memset(regs.guest, -1, sizeof(regs.guest));
+  regs.dirty = 0;
+}
+
+static void emit_write_back(const RegState *st) {
+  int g;
+  for (g = 1; g < 32; g ++) {
+    if (st->dirty & (1u << g)) { x86_store32(REG_CPU, GPR_OFF(g), st->host[g]); }
+  }
+}
+
+static void regs_flush() {
+  emit_write_back(&regs);
+  regs.dirty = 0;
+}
+
+static int reg_use(int h) {
+  locked |= 1u << h;
+  lru[h] = ++ lru_clock;
+  return h;
+}
+
+// a free host register, or the least recently used one which is spilled
+static int reg_alloc() {
+  int victim = -1;
+  int i;
+  for (i = 0; i < ARRLEN(reg_pool); i ++) {
+    int h = reg_pool[i];
+    if (locked & (1u << h)) continue;
+    if (regs.guest[h] < 0) { victim = h; break; }
+    if (victim < 0 || lru[h] < lru[victim]) victim = h;
+  }
+  Assert(victim >= 0, "no host register is available");
+  int g = regs.guest[victim];
+  if (g >= 0) {
+    if (regs.dirty & (1u << g)) { x86_store32(REG_CPU, GPR_OFF(g), victim); }
+    regs.dirty &= ~(1u << g);
+    regs.host[g] = -1;
+    regs.guest[victim] = -1;
+  }
+  return victim;
+}
+
+// host register holding the value of guest register `g'
+static int reg_src(int g) {
+  int h = regs.host[g];
+  if (h < 0) {
+    h = reg_alloc();
+    if (g == 0) x86_alu_rr(ALU_XOR, h, h);
+    else x86_load32(h, REG_CPU, GPR_OFF(g));
+    regs.host[g] = h;
+    regs.guest[h] = g;
+  }
+  return reg_use(h);
+}
+
+// Host register to receive the new value of guest register `g'.
+// The value written to $zero goes to a register which is not cached.
+static int reg_dst(int g) {
+  if (g == 0) return reg_use(reg_alloc());
+  int h = regs.host[g];
+  if (h < 0) {
+    h = reg_alloc();
+    regs.host[g] = h;
+    regs.guest[h] = g;
+  }
+  regs.dirty |= 1u << g;
+  return reg_use(h);
+}
+
+// --- block exits ---
+
+static void emit_exit(int n) {
+  x86_alu64_ri(ALU_ADD, REG_NINST, n);
+  x86_jmp_to(dbt_leave);
+}
+
+// Leave if the chaining limit is reached, an interrupt may be pending,
+// or NEMU is no longer running, with cpu.pc set. These are what the
+// threaded engine checks before chaining, so both take interrupts at
+// the same block boundaries. EAX may hold the target of jalr.
+static Exit* emit_exit_chained(int n) {
+  x86_alu64_ri(ALU_ADD, REG_NINST, n);
+  x86_cmp64_rm(REG_NINST, RSP, 0);
+  x86_jcc_to(CC_A, dbt_leave);
+  x86_mov64_ri(RDX, (uintptr_t)&g_intr_check);
+  x86_cmp8_imm(RDX, 0, 0);
+  x86_jcc_to(CC_NE, dbt_leave);
+  x86_mov64_ri(RDX, (uintptr_t)&nemu_state.state);
+  x86_cmp32_imm(RDX, 0, NEMU_RUNNING);
+  x86_jcc_to(CC_NE, dbt_leave);
+  Exit *e = &exits[nr_exit ++];
+  e->victim = 0;
+  return e;
+}
+
+static void emit_exit_tail(Exit *e) {
+  e->tail = x86_code;
+  int i;
+  for (i = 0; i < e->nr; i ++) x86_patch(e->jump[i], e->tail);
+  x86_mov64_ri(RDX, (uintptr_t)e);
+  x86_jmp_to(dbt_leave_exit);
+}
+
+static void emit_exit_to(vaddr_t pc, int n) {
+  regs_flush();
+  x86_store32_imm(REG_CPU, PC_OFF, pc);
+  Exit *e = emit_exit_chained(n);
+  e->nr = 1;
+  e->cmp[0] = NULL;
+  e->jump[0] = x86_jmp();
+  emit_exit_tail(e);
+}
+
+// the target is in EAX
+static void emit_exit_indirect(int n) {
+  regs_flush();
+  x86_store32(REG_CPU, PC_OFF, RAX);
+  Exit *e = emit_exit_chained(n);
+  e->nr = NR_JALR_CACHE;
+  int i;
+  for (i = 0; i < NR_JALR_CACHE; i ++) {
+    e->cmp[i] = x86_cmp_ri32(RAX, PC_INVALID);
+    e->jump[i] = x86_jcc(CC_E);
+  }
+  emit_exit_tail(e);
+}
+
+// record the instructions executed before the n-th one in the block
+static void emit_nr_before_call(int n) {
+  x86_mov64_rr(RDX, REG_NINST);
+  x86_alu64_ri(ALU_ADD, RDX, n - 1);
+  x86_mov64_ri(RAX, (uintptr_t)&nr_before_call);
+  x86_store64(RAX, 0, RDX);
+}
+
+// Execute the instruction with its execution helper in the interpreter.
+// The helper may change the control flow or the state of NEMU, so the
+// block always ends here.
+static void emit_helper(Decode *s, int n) {
+  Decode *d = &helper_decode[nr_helper_decode ++];
+  *d = *s;
+  regs_flush();
+  regs_reset();
+  x86_store32_imm(REG_CPU, PC_OFF, s->pc);
+  emit_nr_before_call(n);
+  x86_mov64_ri(RDI, (uintptr_t)d);
+  x86_store32_imm(RDI, offsetof(Decode, dnpc), s->snpc);
+  x86_call(d->isa.EHelper);
+  x86_mov64_ri(RAX, (uintptr_t)&d->dnpc);
+  x86_load32(RAX, RAX, 0);
+  x86_store32(REG_CPU, PC_OFF, RAX);
+  emit_exit(n);
+}
+
+// --- memory accesses ---
+
+/* A load or store accesses pmem directly with the guest address minus
+ * CONFIG_MBASE in ECX. Other addresses, as well as stores to pages
+ * holding translated code, go to a stub at the end of the block, which
+ * calls vaddr_read() or vaddr_write(). If some block is dropped by the
+ * store, the current block may be one of them, so it ends after the store.
+ * Blocks translated with the MMU on always go to the stub, and they are
+ * dropped when the translation changes.
+ */
+typedef struct {
+  uint8_t *jump[2]; // rel32 of the jumps to the stub
+  uint8_t *resume;
+  RegState regs;    // register allocation at the instruction
+  vaddr_t pc, snpc;
+  int n, len;
+  bool store, sign;
+  int reg;          // destination of loads or source of stores
+} Stub;
+
+static Stub stubs[BLOCK_MAX_INSTR];
+static int nr_stub = 0;
+static bool mmu_direct = true;
+
+static Stub* new_stub(Decode *s, int n, int len, bool store, bool sign, int reg) {
+  Stub *st = &stubs[nr_stub ++];
+  st->jump[0] = st->jump[1] = NULL;
+  st->regs = regs;
+  st->pc = s->pc;
+  st->snpc = s->snpc;
+  st->n = n;
+  st->len = len;
+  st->store = store;
+  st->sign = sign;
+  st->reg = reg;
+  return st;
+}
+
+// ECX = guest address - CONFIG_MBASE, and jump to the stub if not in pmem
+static uint8_t* emit_pmem_check(int base, word_t imm) {
+  x86_lea(RCX, base, (int32_t)(imm - CONFIG_MBASE));
+  // the memory tracer sees the accesses to pmem in paddr_read() and paddr_write()
+  if (!mmu_direct || MUXDEF(CONFIG_MTRACE, mtrace_pmem(), false)) return x86_jmp();
+  x86_alu_ri(ALU_CMP, RCX, CONFIG_MSIZE);
+  return x86_jcc(CC_AE);
+}
+
+static void emit_load(Decode *s, int n, int len, bool sign) {
+  int h1 = reg_src(s->isa.rs1);
+  // the stub still writes back the old value of rd if it is newer than
+  // that in `cpu', since vaddr_read() may raise an exception
+  bool rd_dirty = regs.dirty & (1u << s->isa.rd);
+  int hd = reg_dst(s->isa.rd);
+  uint8_t *slow = emit_pmem_check(h1, s->isa.imm);
+  x86_load_idx(hd, REG_PMEM, RCX, len, sign);
+  Stub *st = new_stub(s, n, len, false, sign, hd);
+  if (!rd_dirty) st->regs.dirty &= ~(1u << s->isa.rd);
+  st->jump[0] = slow;
+  st->resume = x86_code;
+}
+
+static void emit_store(Decode *s, int n, int len) {
+  int h1 = reg_src(s->isa.rs1);
+  int h2 = reg_src(s->isa.rs2);
+  uint8_t *slow = emit_pmem_check(h1, s->isa.imm);
+  x86_mov_rr(RDX, RCX);
+  x86_shift_ri(SHIFT_SHR, RDX, PAGE_SHIFT);
+  x86_mov64_ri(RAX, (uintptr_t)code_pages);
+  x86_cmp8_idx_imm(RAX, RDX, 0);
+  uint8_t *code = x86_jcc(CC_NE);
+  x86_store_idx(REG_PMEM, RCX, h2, len);
+  Stub *st = new_stub(s, n, len, true, false, h2);
+  st->jump[0] = slow;
+  st->jump[1] = code;
+  st->resume = x86_code;
+}
+
+static void emit_stub(Stub *st) {
+  int i;
+  for (i = 0; i < 2; i ++) {
+    if (st->jump[i] != NULL) x86_patch(st->jump[i], x86_code);
+  }
+  // keep `cpu' up to date for devices, exceptions and error messages
+  emit_write_back(&st->regs);
+  x86_store32_imm(REG_CPU, PC_OFF, st->pc);
+  emit_nr_before_call(st->n);
+
+  // save the caller-saved registers caching guest registers
+  int saved[ARRLEN(reg_pool)];
+  int nr_saved = 0;
+  for (i = 0; i < ARRLEN(reg_pool); i ++) {
+    int h = reg_pool[i];
+    if (CALLER_SAVED(h) && st->regs.guest[h] >= 0) saved[nr_saved ++] = h;
+  }
+  for (i = 0; i < nr_saved; i ++) x86_push(saved[i]);
+  if (nr_saved & 1) x86_alu64_ri(ALU_SUB, RSP, 8); // keep RSP 16-byte aligned
+
+  if (st->store) x86_mov_rr(RDX, st->reg);
+  x86_lea(RDI, RCX, (int32_t)CONFIG_MBASE);
+  x86_mov_ri(RSI, st->len);
+  x86_call(st->store ? (void *)vaddr_write : (void *)vaddr_read);
+
+  if (nr_saved & 1) x86_alu64_ri(ALU_ADD, RSP, 8);
+  for (i = nr_saved - 1; i >= 0; i --) x86_pop(saved[i]);
+
+  if (st->store) {
+    x86_mov64_ri(RAX, (uintptr_t)&stale);
+    x86_cmp8_imm(RAX, 0, 0);
+    x86_jcc_to(CC_E, st->resume);
+    emit_write_back(&st->regs);
+    x86_store32_imm(REG_CPU, PC_OFF, st->snpc);
+    emit_exit(st->n);
+  } else {
+    x86_ext_eax(st->len, st->sign);
+    x86_mov_rr(st->reg, RAX);
+    x86_jmp_to(st->resume);
+  }
+}
+
+// --- instructions ---
+
+static void emit_alu_rr(int op, bool commutative, int rd, int rs1, int rs2) {
+  int h1 = reg_src(rs1), h2 = reg_src(rs2), hd = reg_dst(rd);
+  if (hd == h1) x86_alu_rr(op, hd, h2);
+  else if (hd != h2) { x86_mov_rr(hd, h1); x86_alu_rr(op, hd, h2); }
+  else if (commutative) x86_alu_rr(op, hd, h1);
+  else { x86_mov_rr(RAX, h1); x86_alu_rr(op, RAX, h2); x86_mov_rr(hd, RAX); }
+}
+
+static void emit_alu_ri(int op, int rd, int rs1, word_t imm) {
+  int h1 = reg_src(rs1), hd = reg_dst(rd);
+  if (hd != h1) x86_mov_rr(hd, h1);
+  x86_alu_ri(op, hd, imm);
+}
+
+static void emit_shift_ri(int op, int rd, int rs1, word_t imm) {
+  int h1 = reg_src(rs1), hd = reg_dst(rd);
+  if (hd != h1) x86_mov_rr(hd, h1);
+  x86_shift_ri(op, hd, imm & 0x1f);
+}
+
+static void emit_shift_rr(int op, int rd, int rs1, int rs2) {
+  int h1 = reg_src(rs1), h2 = reg_src(rs2), hd = reg_dst(rd);
+  x86_mov_rr(RCX, h2); // the shift amount is masked with 0x1f by the host
+  x86_mov_rr(RAX, h1);
+  x86_shift_rcl(op, RAX);
+  x86_mov_rr(hd, RAX);
+}
+
+static void emit_set(int cc, int rd, int rs1, int rs2, bool use_imm, word_t imm) {
+  int h1 = reg_src(rs1);
+  int h2 = (use_imm ? -1 : reg_src(rs2));
+  int hd = reg_dst(rd);
+  if (use_imm) x86_alu_ri(ALU_CMP, h1, imm);
+  else x86_alu_rr(ALU_CMP, h1, h2);
+  x86_setcc_eax(cc);
+  x86_mov_rr(hd, RAX);
+}
+
+// the high 32 bits of the 64-bit product
+static void emit_mulh(int rd, int rs1, int rs2, bool sign1, bool sign2) {
+  int h1 = reg_src(rs1), h2 = reg_src(rs2), hd = reg_dst(rd);
+  if (sign1) x86_movsxd(RAX, h1); else x86_mov_rr(RAX, h1);
+  if (sign2) x86_movsxd(RDX, h2); else x86_mov_rr(RDX, h2);
+  x86_imul64_rr(RAX, RDX);
+  x86_shift64_ri(SHIFT_SHR, RAX, 32);
+  x86_mov_rr(hd, RAX);
+}
+
+// Division by zero and overflow trap on the host,
+// which is also what the C code in the interpreter does.
+static void emit_div(int rd, int rs1, int rs2, bool sign, bool rem) {
+  int h1 = reg_src(rs1), h2 = reg_src(rs2), hd = reg_dst(rd);
+  x86_mov_rr(RAX, h1);
+  if (sign) x86_cdq(); else x86_alu_rr(ALU_XOR, RDX, RDX);
+  x86_div_r(h2, sign);
+  x86_mov_rr(hd, rem ? RDX : RAX);
+}
+
+static void emit_branch(Decode *s, int n, int cc) {
+  int h1 = reg_src(s->isa.rs1), h2 = reg_src(s->isa.rs2);
+  regs_flush();
+  x86_alu_rr(ALU_CMP, h1, h2);
+  uint8_t *taken = x86_jcc(cc);
+  emit_exit_to(s->snpc, n);
+  x86_patch(taken, x86_code);
+  emit_exit_to(s->pc + s->isa.imm, n);
+}
+
+// Return whether the block ends at this instruction.
+// `n' is the number of instructions in the block up to this one.
+static bool translate_inst(Decode *s, int n) {
+  int rd = s->isa.rd, rs1 = s->isa.rs1, rs2 = s->isa.rs2;
+  word_t imm = s->isa.imm;
+  locked = 0;
+  switch (s->isa.id) {
+    case INSTR_lui:   x86_mov_ri(reg_dst(rd), imm); break;
+    case INSTR_auipc: x86_mov_ri(reg_dst(rd), s->pc + imm); break;
+    case INSTR_jal:
+      if (rd != 0) x86_mov_ri(reg_dst(rd), s->snpc);
+      emit_exit_to(s->pc + imm, n);
+      return true;
+    case INSTR_jalr: {
+      x86_lea(RAX, reg_src(rs1), imm);
+      if (rd != 0) x86_mov_ri(reg_dst(rd), s->snpc);
+      emit_exit_indirect(n);
+      return true;
+    }
+    case INSTR_beq:  emit_branch(s, n, CC_E);  return true;
+    case INSTR_bne:  emit_branch(s, n, CC_NE); return true;
+    case INSTR_blt:  emit_branch(s, n, CC_L);  return true;
+    case INSTR_bge:  emit_branch(s, n, CC_GE); return true;
+    case INSTR_bltu: emit_branch(s, n, CC_B);  return true;
+    case INSTR_bgeu: emit_branch(s, n, CC_AE); return true;
+    case INSTR_lb:  emit_load(s, n, 1, true);  break;
+    case INSTR_lh:  emit_load(s, n, 2, true);  break;
+    case INSTR_lw:  emit_load(s, n, 4, false); break;
+    case INSTR_lbu: emit_load(s, n, 1, false); break;
+    case INSTR_lhu: emit_load(s, n, 2, false); break;
+    case INSTR_sb: emit_store(s, n, 1); break;
+    case INSTR_sh: emit_store(s, n, 2); break;
+    case INSTR_sw: emit_store(s, n, 4); break;
+    case INSTR_addi:
+      if (rs1 == 0) { x86_mov_ri(reg_dst(rd), imm); break; }
+      else {
+        int h1 = reg_src(rs1), hd = reg_dst(rd);
+        if (hd != h1) x86_lea(hd, h1, imm);
+        else if (imm != 0) x86_alu_ri(ALU_ADD, hd, imm);
+      }
+      break;
+    case INSTR_slti:  emit_set(CC_L, rd, rs1, 0, true, imm); break;
+    case INSTR_sltiu: emit_set(CC_B, rd, rs1, 0, true, imm); break;
+    case INSTR_xori: emit_alu_ri(ALU_XOR, rd, rs1, imm); break;
+    case INSTR_ori:  emit_alu_ri(ALU_OR,  rd, rs1, imm); break;
+    case INSTR_andi: emit_alu_ri(ALU_AND, rd, rs1, imm); break;
+    case INSTR_slli: emit_shift_ri(SHIFT_SHL, rd, rs1, imm); break;
+    case INSTR_srli: emit_shift_ri(SHIFT_SHR, rd, rs1, imm); break;
+    case INSTR_srai: emit_shift_ri(SHIFT_SAR, rd, rs1, imm); break;
+    case INSTR_add: emit_alu_rr(ALU_ADD, true,  rd, rs1, rs2); break;
+    case INSTR_sub: emit_alu_rr(ALU_SUB, false, rd, rs1, rs2); break;
+    case INSTR_xor: emit_alu_rr(ALU_XOR, true,  rd, rs1, rs2); break;
+    case INSTR_or:  emit_alu_rr(ALU_OR,  true,  rd, rs1, rs2); break;
+    case INSTR_and: emit_alu_rr(ALU_AND, true,  rd, rs1, rs2); break;
+    case INSTR_sll: emit_shift_rr(SHIFT_SHL, rd, rs1, rs2); break;
+    case INSTR_srl: emit_shift_rr(SHIFT_SHR, rd, rs1, rs2); break;
+    case INSTR_sra: emit_shift_rr(SHIFT_SAR, rd, rs1, rs2); break;
+    case INSTR_slt:  emit_set(CC_L, rd, rs1, rs2, false, 0); break;
+    case INSTR_sltu: emit_set(CC_B, rd, rs1, rs2, false, 0); break;
+    case INSTR_mul: {
+      int h1 = reg_src(rs1), h2 = reg_src(rs2), hd = reg_dst(rd);
+      x86_mov_rr(RAX, h1);
+      x86_imul_rr(RAX, h2);
+      x86_mov_rr(hd, RAX);
+      break;
+    }
+    case INSTR_mulh:   emit_mulh(rd, rs1, rs2, true,  true);  break;
+    case INSTR_mulhsu: emit_mulh(rd, rs1, rs2, true,  false); break;
+    case INSTR_mulhu:  emit_mulh(rd, rs1, rs2, false, false); break;
+    case INSTR_div:  emit_div(rd, rs1, rs2, true,  false); break;
+    case INSTR_divu: emit_div(rd, rs1, rs2, false, false); break;
+    case INSTR_rem:  emit_div(rd, rs1, rs2, true,  true);  break;
+    case INSTR_remu: emit_div(rd, rs1, rs2, false, true);  break;
+    case INSTR_fence: break;
+    default: emit_helper(s, n); return true;
+  }
+  return false;
+}
+
+// --- blocks ---
+
+void block_flush() {
+  x86_code = code_start;
+  nr_block = 0;
+  nr_helper_decode = 0;
+  nr_exit = 0;
+  nr_link = 0;
+  memset(block_table, 0, sizeof(block_table));
+  memset(page_blocks, 0, sizeof(page_blocks));
+  nr_flush ++;
+}
+
+static Block* translate(vaddr_t pc) {
+  if (x86_code + BLOCK_CODE_MAX > code_cache + CODE_CACHE_SIZE || nr_block == NR_BLOCK ||
+      nr_helper_decode + BLOCK_MAX_INSTR > NR_HELPER_DECODE) {
+    block_flush();
+  }
+
+  Block *b = &blocks[nr_block ++];
+  b->pc = pc;
+  b->code = x86_code;
+  b->in = NULL;
+  regs_reset();
+  nr_stub = 0;
+  mmu_direct = (isa_mmu_check(pc, 4, MEM_TYPE_READ) == MMU_DIRECT);
+
+  Decode s;
+  vaddr_t next = pc;
+  int n = 0;
+  bool end = false;
+  while (!end) {
+    s.pc = next;
+    s.snpc = next;
+    isa_fetch_decode(&s);
+    next = s.snpc;
+    n ++;
+    end = translate_inst(&s, n);
+    // a block never crosses a page, so that it is dropped with the page
+    if (!end && (n == BLOCK_MAX_INSTR || (next & PAGE_MASK) == 0 || block_may_cross_page(next))) {
+      emit_exit_to(next, n);
+      end = true;
+    }
+  }
+  int i;
+  for (i = 0; i < nr_stub; i ++) emit_stub(&stubs[i]);
+  Assert(x86_code <= b->code + BLOCK_CODE_MAX, "host code of the block at " FMT_WORD " is too long", pc);
+
+  b->end = next;
+  Block **head = &page_blocks[(pc - CONFIG_MBASE) >> PAGE_SHIFT];
+  b->next = *head;
+  *head = b;
+  pmem_mark_code(pc);
+  block_table[table_idx(pc)] = b;
+  nr_translate ++;
+  return b;
+}
+
+static uint8_t* jump_target(uint8_t *rel32) {
+  int32_t off;
+  memcpy(&off, rel32, 4);
+  return rel32 + 4 + off;
+}
+
+// Chain the block at cpu.pc, if any, to the exit `e'.
+static void chain(Exit *e) {
+  Block *b = block_table[table_idx(cpu.pc)];
+  if (b == NULL || b->pc != cpu.pc || nr_link == NR_LINK) return;
+  int i = e->victim;
+  // the oldest target of jalr is replaced
+  e->victim = (i + 1) % e->nr;
+  if (e->cmp[i] != NULL) memcpy(e->cmp[i], &cpu.pc, 4);
+  x86_patch(e->jump[i], b->code);
+  Link *l = &links[nr_link ++];
+  l->exit = e;
+  l->i = i;
+  l->next = b->in;
+  b->in = l;
+  nr_chain ++;
+}
+
+static void unchain(Block *b) {
+  Link *l;
+  for (l = b->in; l != NULL; l = l->next) {
+    Exit *e = l->exit;
+    // the entry of jalr may be chained to another block now
+    if (jump_target(e->jump[l->i]) != b->code) continue;
+    if (e->cmp[l->i] != NULL) {
+      vaddr_t invalid = PC_INVALID;
+      memcpy(e->cmp[l->i], &invalid, 4);
+    }
+    x86_patch(e->jump[l->i], e->tail);
+  }
+  b->in = NULL;
+}
+
+uint64_t block_exec(vaddr_t pc, uint64_t n) {
+  int idx = table_idx(pc);
+  Block *b = block_table[idx];
+  if (b == NULL || b->pc != pc) {
+    if (block_may_cross_page(pc) || !vaddr_code_cacheable(pc) ||
+        ++ hotness[idx] < CONFIG_DBT_HOT_THRESHOLD) return 0;
+    hotness[idx] = 0;
+    b = translate(pc);
+  }
+  stale = false;
+  uint64_t flush = nr_flush;
+  running = true;
+  DBTResult r = dbt_enter(b->code, n - BLOCK_MAX_INSTR);
+  running = false;
+  g_nr_block_inst += r.n;
+  nr_exec ++;
+  if (r.exit != NULL && flush == nr_flush) chain(r.exit);
+  return r.n;
+}
+
+uint64_t block_nr_inst() {
+  return (running ? nr_before_call : 0);
+}
+
+// `cpu' is up to date before a helper or a stub is called
+vaddr_t block_pc() {
+  return cpu.pc;
+}
+
+uint64_t block_exception() {
+  if (!running) return 0;
+  running = false;
+  g_nr_block_inst += nr_before_call;
+  nr_exec ++;
+  return nr_before_call;
+}
+
+static void invalidate_page(paddr_t addr, int len) {
+  Block **p = &page_blocks[(addr - CONFIG_MBASE) >> PAGE_SHIFT];
+  while (*p != NULL) {
+    Block *b = *p;
+    if (addr < b->end && addr + len > b->pc) {
+      *p = b->next;
+      Block **slot = &block_table[table_idx(b->pc)];
+      if (*slot == b) *slot = NULL;
+      unchain(b);
+      stale = true;
+    } else {
+      p = &b->next;
+    }
+  }
+}
+
+void block_invalidate(paddr_t addr, int len) {
+  invalidate_page(addr, len);
+  paddr_t last = addr + len - 1;
+  if ((last >> PAGE_SHIFT) != (addr >> PAGE_SHIFT) && in_pmem(last)) invalidate_page(last, len);
+}
+
+void block_statistic() {
+  Log("dbt: translated blocks = %" PRIu64 ", code cache flushes = %" PRIu64 ", links = %" PRIu64
+      ", guest instructions in translated code = %" PRIu64 " in %" PRIu64 " runs",
+      nr_translate, nr_flush, nr_chain, g_nr_block_inst, nr_exec);
+}
+
+void init_dbt() {
+  code_cache = mmap(NULL, CODE_CACHE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  Assert(code_cache != MAP_FAILED, "failed to allocate the code cache");
+  code_pages = pmem_code_pages();
+  x86_code = code_cache;
+
+  // DBTResult dbt_enter(uint8_t *code, uint64_t limit)
+  dbt_enter = (void *)x86_code;
+  x86_push(RBX); x86_push(RBP); x86_push(R12);
+  x86_push(R13); x86_push(R14); x86_push(R15);
+  x86_alu64_ri(ALU_SUB, RSP, 8); // keep RSP 16-byte aligned
+  x86_store64(RSP, 0, RSI);
+  x86_mov64_ri(REG_CPU, (uintptr_t)&cpu);
+  x86_mov64_ri(REG_PMEM, (uintptr_t)guest_to_host(CONFIG_MBASE));
+  x86_alu_rr(ALU_XOR, REG_NINST, REG_NINST);
+  x86_jmp_r(RDI);
+
+  // every block ends by jumping here, or to dbt_leave_exit with the exit in RDX
+  dbt_leave = x86_code;
+  x86_alu_rr(ALU_XOR, RDX, RDX);
+  dbt_leave_exit = x86_code;
+  x86_mov64_rr(RAX, REG_NINST);
+  x86_alu64_ri(ALU_ADD, RSP, 8);
+  x86_pop(R15); x86_pop(R14); x86_pop(R13);
+  x86_pop(R12); x86_pop(RBP); x86_pop(RBX);
+  x86_ret();
+
+  code_start = x86_code;
+  Log("dbt: code cache = %d MB, hot threshold = %d", CONFIG_DBT_CODE_CACHE_SIZE, CONFIG_DBT_HOT_THRESHOLD);
+}
@@ -0,0 +1,241 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __X86_H__
+#define __X86_H__
+
+#include <common.h>
+
+/* A tiny x86-64 assembler. Only the instruction forms needed by the
+ * translator are provided. Operations on guest registers are 32-bit,
+ * which zero-extend the results into the full host registers.
+ */
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+enum { CC_O, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+       CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G };
+// the `/digit' of group 1 instructions
+enum { ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7 };
+// the `/digit' of group 2 instructions
+enum { SHIFT_SHL = 4, SHIFT_SHR = 5, SHIFT_SAR = 7 };
+
+extern uint8_t *x86_code; // where the next instruction is emitted
+
+static inline void emit8(uint8_t v) { *x86_code ++ = v; }
+static inline void emit32(uint32_t v) { memcpy(x86_code, &v, 4); x86_code += 4; }
+static inline void emit64(uint64_t v) { memcpy(x86_code, &v, 8); x86_code += 8; }
+
+// `byte' forces a REX prefix, so that the low byte of
+// RSP/RBP/RSI/RDI is addressed instead of AH/CH/DH/BH
+static inline void rex(int w, int r, int x, int b, bool byte) {
+  uint8_t v = 0x40 | (w << 3) | ((r >> 3) << 2) | ((x >> 3) << 1) | (b >> 3);
+  if (v != 0x40 || byte) emit8(v);
+}
+
+static inline void modrm(int mod, int reg, int rm) {
+  emit8((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+// operand [base + disp]
+static inline void mem_disp(int reg, int base, int32_t disp) {
+  int mod = (disp == 0 && (base & 7) != RBP) ? 0 : (disp == (int8_t)disp ? 1 : 2);
+  modrm(mod, reg, base);
+  if ((base & 7) == RSP) emit8(0x24);
+  if (mod == 1) emit8(disp);
+  else if (mod == 2) emit32(disp);
+}
+
+// operand [base + index], index should not be RSP
+static inline void mem_index(int reg, int base, int index) {
+  int mod = ((base & 7) == RBP ? 1 : 0);
+  modrm(mod, reg, RSP);
+  emit8(((index & 7) << 3) | (base & 7));
+  if (mod == 1) emit8(0);
+}
+
+// --- 32-bit register operations ---
+
+static inline void x86_mov_rr(int dst, int src) {
+  rex(0, src, 0, dst, false); emit8(0x89); modrm(3, src, dst);
+}
+
+static inline void x86_mov_ri(int dst, uint32_t imm) {
+  rex(0, 0, 0, dst, false); emit8(0xb8 + (dst & 7)); emit32(imm);
+}
+
+static inline void x86_alu_rr(int op, int dst, int src) {
+  rex(0, src, 0, dst, false); emit8(op * 8 + 1); modrm(3, src, dst);
+}
+
+static inline void x86_alu_ri(int op, int dst, int32_t imm) {
+  rex(0, 0, 0, dst, false);
+  if (imm == (int8_t)imm) { emit8(0x83); modrm(3, op, dst); emit8(imm); }
+  else { emit8(0x81); modrm(3, op, dst); emit32(imm); }
+}
+
+// compare with an imm32 which is patched later, return the imm32 field
+static inline uint8_t* x86_cmp_ri32(int dst, uint32_t imm) {
+  rex(0, 0, 0, dst, false); emit8(0x81); modrm(3, ALU_CMP, dst); emit32(imm);
+  return x86_code - 4;
+}
+
+static inline void x86_test_rr(int a, int b) {
+  rex(0, b, 0, a, false); emit8(0x85); modrm(3, b, a);
+}
+
+static inline void x86_shift_ri(int op, int dst, int imm) {
+  rex(0, 0, 0, dst, false); emit8(0xc1); modrm(3, op, dst); emit8(imm);
+}
+
+// shift by CL
+static inline void x86_shift_rcl(int op, int dst) {
+  rex(0, 0, 0, dst, false); emit8(0xd3); modrm(3, op, dst);
+}
+
+static inline void x86_imul_rr(int dst, int src) {
+  rex(0, dst, 0, src, false); emit8(0x0f); emit8(0xaf); modrm(3, dst, src);
+}
+
+// EDX:EAX / src, signed or unsigned
+static inline void x86_div_r(int src, bool sign) {
+  rex(0, 0, 0, src, false); emit8(0xf7); modrm(3, sign ? 7 : 6, src);
+}
+
+static inline void x86_cdq() { emit8(0x99); }
+
+// dst = lea [base + disp], truncated to 32 bits
+static inline void x86_lea(int dst, int base, int32_t disp) {
+  rex(0, dst, 0, base, false); emit8(0x8d); mem_disp(dst, base, disp);
+}
+
+// AL = cc ? 1 : 0; EAX = AL
+static inline void x86_setcc_eax(int cc) {
+  emit8(0x0f); emit8(0x90 + cc); modrm(3, 0, RAX);
+  emit8(0x0f); emit8(0xb6); modrm(3, RAX, RAX);
+}
+
+// EAX = sign or zero extension of AL/AX
+static inline void x86_ext_eax(int len, bool sign) {
+  if (len == 4) return;
+  emit8(0x0f); emit8((sign ? 0xbe : 0xb6) + (len == 2)); modrm(3, RAX, RAX);
+}
+
+// --- 64-bit register operations ---
+
+static inline void x86_mov64_ri(int dst, uint64_t imm) {
+  rex(1, 0, 0, dst, false); emit8(0xb8 + (dst & 7)); emit64(imm);
+}
+
+static inline void x86_mov64_rr(int dst, int src) {
+  rex(1, src, 0, dst, false); emit8(0x89); modrm(3, src, dst);
+}
+
+static inline void x86_alu64_ri(int op, int dst, int32_t imm) {
+  rex(1, 0, 0, dst, false);
+  if (imm == (int8_t)imm) { emit8(0x83); modrm(3, op, dst); emit8(imm); }
+  else { emit8(0x81); modrm(3, op, dst); emit32(imm); }
+}
+
+static inline void x86_shift64_ri(int op, int dst, int imm) {
+  rex(1, 0, 0, dst, false); emit8(0xc1); modrm(3, op, dst); emit8(imm);
+}
+
+// compare reg with [base + disp]
+static inline void x86_cmp64_rm(int reg, int base, int32_t disp) {
+  rex(1, reg, 0, base, false); emit8(0x3b); mem_disp(reg, base, disp);
+}
+
+static inline void x86_imul64_rr(int dst, int src) {
+  rex(1, dst, 0, src, false); emit8(0x0f); emit8(0xaf); modrm(3, dst, src);
+}
+
+static inline void x86_movsxd(int dst, int src) {
+  rex(1, dst, 0, src, false); emit8(0x63); modrm(3, dst, src);
+}
+
+static inline void x86_push(int r) { rex(0, 0, 0, r, false); emit8(0x50 + (r & 7)); }
+static inline void x86_pop(int r)  { rex(0, 0, 0, r, false); emit8(0x58 + (r & 7)); }
+static inline void x86_ret() { emit8(0xc3); }
+
+// --- memory operations ---
+
+static inline void x86_load32(int dst, int base, int32_t disp) {
+  rex(0, dst, 0, base, false); emit8(0x8b); mem_disp(dst, base, disp);
+}
+
+static inline void x86_store32(int base, int32_t disp, int src) {
+  rex(0, src, 0, base, false); emit8(0x89); mem_disp(src, base, disp);
+}
+
+static inline void x86_store64(int base, int32_t disp, int src) {
+  rex(1, src, 0, base, false); emit8(0x89); mem_disp(src, base, disp);
+}
+
+static inline void x86_store32_imm(int base, int32_t disp, uint32_t imm) {
+  rex(0, 0, 0, base, false); emit8(0xc7); mem_disp(0, base, disp); emit32(imm);
+}
+
+// dst = sign or zero extension of the `len' bytes at [base + index]
+static inline void x86_load_idx(int dst, int base, int index, int len, bool sign) {
+  rex(0, dst, index, base, false);
+  if (len == 4) emit8(0x8b);
+  else { emit8(0x0f); emit8((sign ? 0xbe : 0xb6) + (len == 2)); }
+  mem_index(dst, base, index);
+}
+
+static inline void x86_store_idx(int base, int index, int src, int len) {
+  if (len == 2) emit8(0x66);
+  rex(0, src, index, base, len == 1 && src >= RSP && src <= RDI);
+  emit8(len == 1 ? 0x88 : 0x89);
+  mem_index(src, base, index);
+}
+
+static inline void x86_cmp8_imm(int base, int32_t disp, uint8_t imm) {
+  rex(0, 0, 0, base, false); emit8(0x80); mem_disp(ALU_CMP, base, disp); emit8(imm);
+}
+
+static inline void x86_cmp32_imm(int base, int32_t disp, int32_t imm) {
+  rex(0, 0, 0, base, false);
+  if (imm == (int8_t)imm) { emit8(0x83); mem_disp(ALU_CMP, base, disp); emit8(imm); }
+  else { emit8(0x81); mem_disp(ALU_CMP, base, disp); emit32(imm); }
+}
+
+static inline void x86_cmp8_idx_imm(int base, int index, uint8_t imm) {
+  rex(0, 0, index, base, false); emit8(0x80); mem_index(ALU_CMP, base, index); emit8(imm);
+}
+
+// --- control transfer ---
+
+// the rel32 fields returned are patched later by x86_patch()
+static inline uint8_t* x86_jcc(int cc) { emit8(0x0f); emit8(0x80 + cc); emit32(0); return x86_code - 4; }
+static inline uint8_t* x86_jmp() { emit8(0xe9); emit32(0); return x86_code - 4; }
+
+static inline void x86_patch(uint8_t *rel32, uint8_t *target) {
+  int32_t off = target - (rel32 + 4);
+  memcpy(rel32, &off, 4);
+}
+
+static inline void x86_jcc_to(int cc, uint8_t *target) { x86_patch(x86_jcc(cc), target); }
+static inline void x86_jmp_to(uint8_t *target) { x86_patch(x86_jmp(), target); }
+
+static inline void x86_jmp_r(int r) { rex(0, 0, 0, r, false); emit8(0xff); modrm(3, 4, r); }
+
+// call an absolute address through RAX
+static inline void x86_call(const void *fn) {
+  x86_mov64_ri(RAX, (uintptr_t)fn);
+  emit8(0xff); modrm(3, 2, RAX);
+}
+
+#endif
@@ -15,3 +15,5 @@
 
 INC_PATH += $(NEMU_HOME)/src/engine/$(ENGINE)
 DIRS-y += src/engine/$(ENGINE)
+# cold code and single steps are still interpreted
+DIRS-$(CONFIG_ENGINE_BLOCK) += src/engine/interpreter
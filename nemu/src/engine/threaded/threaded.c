@@ -0,0 +1,210 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <isa-all-instr.h>
+#include <cpu/block.h>
+#include <cpu/decode.h>
+#include <memory/paddr.h>
+#include <memory/vaddr.h>
+
+/* A block is translated into an array of instructions, each of which
+ * holds the label of its handler in isa_exec_threaded() and the decoded
+ * operands, followed by an entry with the label THREADED_END. Dropping
+ * a block replaces the labels of its instructions with THREADED_STALE,
+ * so that a block which modifies itself ends right after the store.
+ *
+ * The THREADED_END entry points to the links of its block, which are
+ * the blocks run after it recently. isa_exec_threaded() goes on with
+ * them directly. A link to a dropped block ends at THREADED_STALE, and
+ * is updated by block_exec() afterwards.
+ */
+
+#define NR_BLOCK 65536
+#define NR_THREADED_INST (NR_BLOCK * 8)
+#define BLOCK_TABLE_SIZE 65536
+#define NR_PAGE (CONFIG_MSIZE >> PAGE_SHIFT)
+
+typedef struct Block {
+  vaddr_t pc, end; // guest instructions in [pc, end)
+  ThreadedInst *inst;
+  struct Block *next; // the next block in the same page
+  BlockLink link[BLOCK_NR_LINK];
+} Block;
+
+static Block blocks[NR_BLOCK];
+static int nr_block = 0;
+static ThreadedInst insts[NR_THREADED_INST];
+static int nr_inst = 0;
+static Block *block_table[BLOCK_TABLE_SIZE] = {};
+static Block *page_blocks[NR_PAGE] = {};
+
+uint64_t g_nr_block_inst = 0;
+static bool running = false; // in isa_exec_threaded()
+static uint64_t nr_build = 0, nr_flush = 0, nr_exec = 0, nr_link = 0;
+
+static inline int table_idx(vaddr_t pc) { return (pc >> 2) & (BLOCK_TABLE_SIZE - 1); }
+
+static bool ends_block(int id) {
+#define BLOCK_END_CASE(name) case concat(INSTR_, name):
+  switch (id) {
+    MAP(INSTR_BLOCK_END_LIST, BLOCK_END_CASE) return true;
+    default: return false;
+  }
+}
+
+void block_flush() {
+  // the running block may still go on with its links after a helper
+  // flushes the blocks, e.g. by writing satp
+  int i, j;
+  for (i = 0; i < nr_block; i ++) {
+    for (j = 0; j < BLOCK_NR_LINK; j ++) blocks[i].link[j].pc = BLOCK_LINK_INVALID;
+  }
+  nr_block = 0;
+  nr_inst = 0;
+  memset(block_table, 0, sizeof(block_table));
+  memset(page_blocks, 0, sizeof(page_blocks));
+  nr_flush ++;
+}
+
+static Block* build(vaddr_t pc) {
+  if (nr_block == NR_BLOCK || nr_inst + BLOCK_MAX_INSTR + 1 > NR_THREADED_INST) block_flush();
+  if (unlikely(isa_threaded_handler == NULL)) isa_exec_threaded(NULL, 0);
+
+  Block *b = &blocks[nr_block ++];
+  b->pc = pc;
+  b->inst = &insts[nr_inst];
+  int i;
+  for (i = 0; i < BLOCK_NR_LINK; i ++) b->link[i].pc = BLOCK_LINK_INVALID;
+  vaddr_t next = pc;
+  int n = 0;
+  ThreadedInst *t;
+  do {
+    t = &insts[nr_inst ++];
+    t->s.pc = next;
+    t->s.snpc = next;
+    isa_fetch_decode(&t->s);
+    t->handler = isa_threaded_handler[t->s.isa.id];
+    next = t->s.snpc;
+    n ++;
+    // a block never crosses a page, so that it is dropped with the page
+  } while (!ends_block(t->s.isa.id) && n < BLOCK_MAX_INSTR && (next & PAGE_MASK) != 0 &&
+      !block_may_cross_page(next));
+
+  isa_threaded_fuse(b->inst, n);
+
+  t = &insts[nr_inst ++];
+  t->handler = isa_threaded_handler[THREADED_END];
+  t->s.pc = next;
+  t->link = b->link;
+
+  b->end = next;
+  Block **head = &page_blocks[(pc - CONFIG_MBASE) >> PAGE_SHIFT];
+  b->next = *head;
+  *head = b;
+  pmem_mark_code(pc);
+  block_table[table_idx(pc)] = b;
+  nr_build ++;
+  return b;
+}
+
+// Chain the block at cpu.pc, if any, to the block ending at `exit'.
+static void chain(ThreadedInst *exit) {
+  BlockLink *link = exit->link;
+  vaddr_t pc = cpu.pc;
+  Block *b = block_table[table_idx(pc)];
+  int i;
+  if (b == NULL || b->pc != pc) {
+    for (i = 0; i < BLOCK_NR_LINK; i ++) {
+      if (link[i].pc == pc) link[i].pc = BLOCK_LINK_INVALID;
+    }
+    return;
+  }
+  for (i = 0; i < BLOCK_NR_LINK - 1 && link[i].pc != pc; i ++) ;
+  if (link[i].pc != pc) nr_link ++;
+  // the most recent target goes first
+  for (; i > 0; i --) link[i] = link[i - 1];
+  link[0] = (BlockLink) { .pc = pc, .inst = b->inst };
+}
+
+uint64_t block_exec(vaddr_t pc, uint64_t n) {
+  Block *b = block_table[table_idx(pc)];
+  if (b == NULL || b->pc != pc) {
+    if (block_may_cross_page(pc) || !vaddr_code_cacheable(pc)) return 0;
+    b = build(pc);
+  }
+  uint64_t flush = nr_flush;
+  isa_threaded_exit = NULL;
+  running = true;
+  uint64_t nr = isa_exec_threaded(b->inst, n);
+  running = false;
+  g_nr_block_inst += nr;
+  nr_exec ++;
+  if (isa_threaded_exit != NULL && flush == nr_flush && nemu_state.state == NEMU_RUNNING) {
+    chain(isa_threaded_exit);
+  }
+  return nr;
+}
+
+uint64_t block_nr_inst() {
+  vaddr_t pc;
+  return (running ? isa_threaded_position(&pc) : 0);
+}
+
+vaddr_t block_pc() {
+  vaddr_t pc = cpu.pc;
+  if (running) isa_threaded_position(&pc);
+  return pc;
+}
+
+uint64_t block_exception() {
+  if (!running) return 0;
+  running = false;
+  uint64_t nr = isa_threaded_position(&cpu.pc);
+  g_nr_block_inst += nr;
+  nr_exec ++;
+  return nr;
+}
+
+static void invalidate_page(paddr_t addr, int len) {
+  Block **p = &page_blocks[(addr - CONFIG_MBASE) >> PAGE_SHIFT];
+  while (*p != NULL) {
+    Block *b = *p;
+    if (addr < b->end && addr + len > b->pc) {
+      *p = b->next;
+      Block **slot = &block_table[table_idx(b->pc)];
+      if (*slot == b) *slot = NULL;
+      ThreadedInst *t;
+      for (t = b->inst; t->s.pc < b->end; t ++) {
+        t->handler = isa_threaded_handler[THREADED_STALE];
+      }
+    } else {
+      p = &b->next;
+    }
+  }
+}
+
+void block_invalidate(paddr_t addr, int len) {
+  invalidate_page(addr, len);
+  paddr_t last = addr + len - 1;
+  if ((last >> PAGE_SHIFT) != (addr >> PAGE_SHIFT) && in_pmem(last)) invalidate_page(last, len);
+}
+
+void block_statistic() {
+  Log("threaded: built blocks = %" PRIu64 ", flushes = %" PRIu64 ", links = %" PRIu64
+      ", guest instructions in threaded code = %" PRIu64 " in %" PRIu64 " runs",
+      nr_build, nr_flush, nr_link, g_nr_block_inst, nr_exec);
+  isa_threaded_statistic();
+}
@@ -20,3 +20,10 @@
 paddr_t isa_mmu_translate(vaddr_t vaddr, int len, int type) {
   return MEM_RET_FAIL;
 }
+
+word_t isa_mmu_fault(vaddr_t vaddr, int type) {
+  return INTR_EMPTY;
+}
+
+void isa_mmu_statistic() {
+}
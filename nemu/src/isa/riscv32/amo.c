@@ -0,0 +1,100 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <memory/vaddr.h>
+#include "local-include/amo.h"
+#include "local-include/csr.h"
+
+/* The A extension. Harts may run in different host threads, so guest
+ * atomics are host atomics on pmem. With SMP, LR also reserves the word
+ * in pmem, and stores of other harts to it make the SC fail, see
+ * src/cpu/smp.c. An SC then also checks by a host CAS that the word
+ * still holds the value loaded by LR. Other addresses, such as devices,
+ * are accessed without atomicity. Misaligned addresses raise the
+ * address-misaligned exceptions.
+ */
+
+static HART_LOCAL bool reserved = false;
+static HART_LOCAL vaddr_t reserved_addr = 0;
+static HART_LOCAL uint32_t reserved_val = 0;
+// whether the reservation is seen by other harts, i.e. it is in pmem
+IFDEF(CONFIG_SMP, static HART_LOCAL bool reserved_pmem = false);
+
+static void check_align(vaddr_t addr, word_t NO) {
+  if (unlikely(addr & 0x3)) intr_raise_exc(NO, addr);
+}
+
+static uint32_t amo_op(int op, uint32_t old, uint32_t data) {
+  switch (op) {
+    case AMO_SWAP: return data;
+    case AMO_ADD:  return old + data;
+    case AMO_XOR:  return old ^ data;
+    case AMO_AND:  return old & data;
+    case AMO_OR:   return old | data;
+    case AMO_MIN:  return ((int32_t)old < (int32_t)data ? old : data);
+    case AMO_MAX:  return ((int32_t)old > (int32_t)data ? old : data);
+    case AMO_MINU: return (old < data ? old : data);
+    case AMO_MAXU: return (old > data ? old : data);
+    default: panic("bad AMO operation %d", op);
+  }
+}
+
+word_t amo_lr(vaddr_t addr) {
+  check_align(addr, EXC_LAM);
+#ifdef CONFIG_SMP
+  // reserve before loading, so that a later store drops the reservation
+  void *haddr = vaddr_host_read(addr, 4);
+  smp_reserve(haddr);
+  reserved_pmem = (haddr != NULL);
+#endif
+  reserved_val = vaddr_read(addr, 4);
+  reserved_addr = addr;
+  reserved = true;
+  return reserved_val;
+}
+
+word_t amo_sc(vaddr_t addr, word_t data) {
+  check_align(addr, EXC_SAM);
+  bool ok = reserved && reserved_addr == addr;
+  reserved = false;
+  IFDEF(CONFIG_SMP, if (!smp_unreserve() && reserved_pmem) ok = false);
+  if (!ok) return 1;
+  uint32_t *p = vaddr_host_rmw(addr, 4);
+  if (p != NULL) {
+    uint32_t expected = reserved_val;
+    return __atomic_compare_exchange_n(p, &expected, (uint32_t)data, false,
+        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) ? 0 : 1;
+  }
+  if (vaddr_read(addr, 4) != reserved_val) return 1;
+  vaddr_write(addr, 4, data);
+  return 0;
+}
+
+word_t amo_rmw(int op, vaddr_t addr, word_t data) {
+  check_align(addr, EXC_SAM);
+  uint32_t *p = vaddr_host_rmw(addr, 4);
+  if (p != NULL) {
+    if (op == AMO_SWAP) return __atomic_exchange_n(p, (uint32_t)data, __ATOMIC_SEQ_CST);
+    uint32_t old = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(p, &old, amo_op(op, old, data), false,
+          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    return old;
+  }
+  uint32_t old = vaddr_read(addr, 4);
+  vaddr_write(addr, 4, amo_op(op, old, data));
+  return old;
+}
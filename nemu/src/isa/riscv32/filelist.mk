@@ -0,0 +1,32 @@
+#***************************************************************************************
+# Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+#
+# NEMU is licensed under Mulan PSL v2.
+# You can use this software according to the terms and conditions of the Mulan PSL v2.
+# You may obtain a copy of Mulan PSL v2 at:
+#          http://license.coscl.org.cn/MulanPSL2
+#
+# THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+# EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+# MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+#
+# See the Mulan PSL v2 for more details.
+#**************************************************************************************/
+
+ifdef CONFIG_DECODE_TREE
+GEN_DECODE_PATH = $(NEMU_HOME)/tools/gen-decode
+GEN_DECODE = $(GEN_DECODE_PATH)/build/gen-decode
+DECODE_TREE_SRC = src/isa/$(GUEST_ISA)/include/isa-all-instr.h
+DECODE_TREE = $(NEMU_HOME)/include/generated/decode-tree.h
+GEN_HEADERS += $(DECODE_TREE)
+
+$(GEN_DECODE): $(GEN_DECODE_PATH)/gen-decode.c
+	@$(MAKE) -s -C $(GEN_DECODE_PATH)
+
+# switch on opcode, funct3 and funct7 in order
+$(DECODE_TREE): $(DECODE_TREE_SRC) $(GEN_DECODE)
+	@echo + GEN $@
+	@mkdir -p $(dir $@)
+	@$(GEN_DECODE) -f 6:0 -f 14:12 -f 31:25 $< > $@.tmp
+	@mv $@.tmp $@
+endif
@@ -0,0 +1,196 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/decode.h>
+#include <memory/vaddr.h>
+#include <isa-all-instr.h>
+#include "local-include/reg.h"
+
+#ifdef CONFIG_RTC_IDLE
+/* Polling loops of the RTC, see src/device/timer.c. The loop around a
+ * load from the RTC is decoded and taken as polling only if each of its
+ * iterations does the same but for the values read from the RTC:
+ *   - it is straight-line code in one page, from the target of its only
+ *     backward branch or jump, which is at or before the load, to that
+ *     branch or jump, and leaves by forward branches only;
+ *   - it has only loads from the RTC, ALU operations and branches, and
+ *     each branch compares a value derived from the RTC;
+ *   - a register it reads is either written before in the same
+ *     iteration or not written in the loop at all, so that nothing is
+ *     carried from one iteration to the next, e.g. a counter.
+ * Then the loop has no effect but to wait, however many times it runs.
+ */
+#define LOOP_MAX 16 // instructions
+
+#define BIT(r) (1u << (r))
+
+#define ALU_LIST(f) \
+  f(lui) f(auipc) f(addi) f(slti) f(sltiu) f(xori) f(ori) f(andi) \
+  f(slli) f(srli) f(srai) f(add) f(sub) f(sll) f(slt) f(sltu) f(xor) \
+  f(srl) f(sra) f(or) f(and) f(mul) f(mulh) f(mulhsu) f(mulhu) \
+  f(div) f(divu) f(rem) f(remu)
+#define LOAD_LIST(f) f(lb) f(lh) f(lw) f(lbu) f(lhu)
+#define BRANCH_LIST(f) f(beq) f(bne) f(blt) f(bge) f(bltu) f(bgeu)
+#define CASE(name) case concat(INSTR_, name):
+
+static int load_len(int id) {
+  switch (id) {
+    case INSTR_lb: case INSTR_lbu: return 1;
+    case INSTR_lh: case INSTR_lhu: return 2;
+    default: return 4;
+  }
+}
+
+// the registers read by an instruction in the lists above
+static uint32_t sources(ISADecodeInfo *isa) {
+  switch (isa->id) {
+    case INSTR_lui: case INSTR_auipc: case INSTR_jal: return 0;
+    case INSTR_addi: case INSTR_slti: case INSTR_sltiu: case INSTR_xori:
+    case INSTR_ori: case INSTR_andi: case INSTR_slli: case INSTR_srli:
+    case INSTR_srai: LOAD_LIST(CASE) return BIT(isa->rs1) & ~BIT(0);
+    default: return (BIT(isa->rs1) | BIT(isa->rs2)) & ~BIT(0);
+  }
+}
+
+static vaddr_t target(Decode *s) {
+  return s->pc + s->isa.imm;
+}
+
+static bool same_page(vaddr_t a, vaddr_t b) {
+  return (a & ~PAGE_MASK) == (b & ~PAGE_MASK);
+}
+
+static void fetch_decode(Decode *s, vaddr_t pc) {
+  s->pc = pc;
+  s->snpc = pc;
+  isa_fetch_decode(s);
+}
+
+/* Decode the loop around `pc' into `body', and return its number of
+ * instructions, or 0 if it is not straight-line code as above.
+ */
+static int loop_body(vaddr_t pc, Decode *body) {
+  Decode s;
+  vaddr_t head = 0, next = pc;
+  int i;
+  // look for the branch or jump back
+  for (i = 0; i < LOOP_MAX && same_page(next, pc); i ++) {
+    fetch_decode(&s, next);
+    next = s.snpc;
+    switch (s.isa.id) {
+      BRANCH_LIST(CASE) case INSTR_jal:
+        if (target(&s) <= pc) { head = target(&s); goto found; }
+        if (s.isa.id == INSTR_jal || target(&s) < s.pc) return 0;
+        break;
+      case INSTR_jalr: return 0;
+    }
+  }
+  return 0;
+
+found:
+  if (!same_page(head, pc)) return 0;
+  // decode it again from the head
+  int n = 0;
+  for (next = head; n < LOOP_MAX && next <= s.pc; n ++) {
+    fetch_decode(&body[n], next);
+    next = body[n].snpc;
+  }
+  return (next == s.snpc ? n : 0);
+}
+
+bool isa_rtc_poll_loop(vaddr_t pc, int off, int len, bool *has_deadline, word_t *deadline) {
+  Decode body[LOOP_MAX];
+  int n = loop_body(pc, body);
+  if (n == 0) return false;
+  vaddr_t head = body[0].pc;
+
+  uint32_t written = 0;
+  int i;
+  for (i = 0; i < n; i ++) {
+    if (body[i].isa.id != INSTR_jal) written |= BIT(body[i].isa.rd);
+  }
+  written &= ~BIT(0);
+
+  // the address of the RTC, from the load at `pc'
+  for (i = 0; i < n && body[i].pc != pc; i ++);
+  if (i == n) return false;
+  ISADecodeInfo *load = &body[i].isa;
+  if (BIT(load->rs1) & written) return false;
+  vaddr_t rtc = gpr(load->rs1) + load->imm - off;
+
+  uint32_t def = 0, rtc_val = 0;
+  uint32_t low = 0; // registers holding the low word of the RTC as read
+  int nr_branch = 0;
+  Decode *branch = NULL;
+  uint32_t branch_low = 0;
+  for (i = 0; i < n; i ++) {
+    ISADecodeInfo *isa = &body[i].isa;
+    uint32_t src = sources(isa);
+    if (src & written & ~def) return false;
+    uint32_t rd = BIT(isa->rd) & ~BIT(0);
+    switch (isa->id) {
+      LOAD_LIST(CASE) {
+        // the address must not change across iterations
+        if (src & written) return false;
+        vaddr_t addr = gpr(isa->rs1) + isa->imm;
+        if (addr < rtc || addr + load_len(isa->id) > rtc + len) return false;
+        rtc_val |= rd;
+        if (isa->id == INSTR_lw && addr == rtc) low |= rd;
+        else low &= ~rd;
+        break;
+      }
+      ALU_LIST(CASE)
+        if (src & rtc_val) rtc_val |= rd;
+        else rtc_val &= ~rd;
+        low &= ~rd;
+        break;
+      BRANCH_LIST(CASE)
+        if (!(src & rtc_val)) return false;
+        // a branch other than the one back leaves the loop
+        if (i != n - 1 && target(&body[i]) <= body[n - 1].pc) return false;
+        nr_branch ++;
+        branch = &body[i];
+        branch_low = low;
+        break;
+      case INSTR_jal:
+        // only as the jump back
+        if (i != n - 1 || isa->rd != 0) return false;
+        break;
+      default: return false;
+    }
+    def |= rd;
+  }
+
+  /* A deadline is known if the loop waits by one unsigned comparison of
+   * the low word with a register not written in the loop.
+   */
+  *has_deadline = false;
+  if (nr_branch == 1 && (branch->isa.id == INSTR_bltu || branch->isa.id == INSTR_bgeu)) {
+    bool back = (target(branch) == head);
+    // whether it goes on while rs1 < rs2, or else while rs1 >= rs2
+    bool lt = ((branch->isa.id == INSTR_bltu) == back);
+    int rs1 = branch->isa.rs1, rs2 = branch->isa.rs2;
+    if (lt && (branch_low & BIT(rs1)) && !(BIT(rs2) & written)) {
+      *has_deadline = true;
+      *deadline = gpr(rs2);
+    } else if (!lt && (branch_low & BIT(rs2)) && !(BIT(rs1) & written)) {
+      *has_deadline = true;
+      *deadline = gpr(rs1) + 1;
+    }
+  }
+  return true;
+}
+#endif
@@ -0,0 +1,274 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __ISA_ALL_INSTR_H__
+#define __ISA_ALL_INSTR_H__
+
+#include <common.h>
+
+/* All instructions supported by NEMU. The execution body of each item
+ * is expanded in inst.c, where `src1', `src2', `imm', `rd' and `s' are
+ * available. Items are matched in order, and the decode tree generated
+ * from this list by tools/gen-decode keeps this order.
+ */
+// pattern, name, type, execute body
+#define INSTR_LIST(f) \
+  f("??????? ????? ????? ??? ????? 01101 11", lui    , U    , R(rd) = imm                                               )  \
+  f("??????? ????? ????? ??? ????? 00101 11", auipc  , U    , R(rd) = s->pc + imm                                       )  \
+  f("??????? ????? ????? ??? ????? 11011 11", jal    , J    , R(rd) = s->snpc; s->dnpc = s->pc + imm                    )  \
+  f("??????? ????? ????? 000 ????? 11001 11", jalr   , I    , R(rd) = s->snpc; s->dnpc = src1 + imm                     )  \
+  f("??????? ????? ????? 000 ????? 11000 11", beq    , B    , if (src1 == src2) s->dnpc = s->pc + imm                   )  \
+  f("??????? ????? ????? 001 ????? 11000 11", bne    , B    , if (src1 != src2) s->dnpc = s->pc + imm                    ) \
+  f("??????? ????? ????? 100 ????? 11000 11", blt    , B    , if ((sword_t)src1 <  (sword_t)src2) s->dnpc = s->pc + imm )  \
+  f("??????? ????? ????? 101 ????? 11000 11", bge    , B    , if ((sword_t)src1 >= (sword_t)src2) s->dnpc = s->pc + imm )  \
+  f("??????? ????? ????? 110 ????? 11000 11", bltu   , B    , if (src1 <  src2) s->dnpc = s->pc + imm                   )  \
+  f("??????? ????? ????? 111 ????? 11000 11", bgeu   , B    , if (src1 >= src2) s->dnpc = s->pc + imm                   )  \
+  f("??????? ????? ????? 000 ????? 00000 11", lb     , I    , R(rd) = SEXT(Mr(src1 + imm, 1), 8)                        )  \
+  f("??????? ????? ????? 001 ????? 00000 11", lh     , I    , R(rd) = SEXT(Mr(src1 + imm, 2), 16)                       )  \
+  f("??????? ????? ????? 010 ????? 00000 11", lw     , I    , R(rd) = SEXT(Mr(src1 + imm, 4), 32)                       )  \
+  f("??????? ????? ????? 100 ????? 00000 11", lbu    , I    , R(rd) = Mr(src1 + imm, 1)                                 )  \
+  f("??????? ????? ????? 101 ????? 00000 11", lhu    , I    , R(rd) = Mr(src1 + imm, 2)                                 )  \
+  f("??????? ????? ????? 000 ????? 01000 11", sb     , S    , Mw(src1 + imm, 1, src2)                                   )  \
+  f("??????? ????? ????? 001 ????? 01000 11", sh     , S    , Mw(src1 + imm, 2, src2)                                   )  \
+  f("??????? ????? ????? 010 ????? 01000 11", sw     , S    , Mw(src1 + imm, 4, src2)                                   )  \
+  f("??????? ????? ????? 000 ????? 00100 11", addi   , I    , R(rd) = src1 + imm                                        )  \
+  f("??????? ????? ????? 010 ????? 00100 11", slti   , I    , R(rd) = ((sword_t)src1 < (sword_t)imm) ? 1 : 0            )  \
+  f("??????? ????? ????? 011 ????? 00100 11", sltiu  , I    , R(rd) = (src1 < imm) ? 1 : 0                              )  \
+  f("??????? ????? ????? 100 ????? 00100 11", xori   , I    , R(rd) = src1 ^ imm                                        )  \
+  f("??????? ????? ????? 110 ????? 00100 11", ori    , I    , R(rd) = src1 | imm                                        )  \
+  f("??????? ????? ????? 111 ????? 00100 11", andi   , I    , R(rd) = src1 & imm                                        )  \
+  f("0000000 ????? ????? 001 ????? 00100 11", slli   , I    , R(rd) = src1 << (imm & 0x1f)                              )  \
+  f("0000000 ????? ????? 101 ????? 00100 11", srli   , I    , R(rd) = src1 >> (imm & 0x1f)                              )  \
+  f("0100000 ????? ????? 101 ????? 00100 11", srai   , I    , R(rd) = (sword_t)src1 >> (imm & 0x1f)                     )  \
+  f("0000000 ????? ????? 000 ????? 01100 11", add    , R    , R(rd) = src1 + src2                                       )  \
+  f("0100000 ????? ????? 000 ????? 01100 11", sub    , R    , R(rd) = src1 - src2                                       )  \
+  f("0000000 ????? ????? 001 ????? 01100 11", sll    , R    , R(rd) = src1 << (src2 & 0x1f)                             )  \
+  f("0000000 ????? ????? 010 ????? 01100 11", slt    , R    , R(rd) = ((sword_t)src1 < (sword_t)src2) ? 1 : 0           )  \
+  f("0000000 ????? ????? 011 ????? 01100 11", sltu   , R    , R(rd) = (src1 < src2) ? 1 : 0                             )  \
+  f("0000000 ????? ????? 100 ????? 01100 11", xor    , R    , R(rd) = src1 ^ src2                                       )  \
+  f("0000000 ????? ????? 101 ????? 01100 11", srl    , R    , R(rd) = src1 >> (src2 & 0x1f)                             )  \
+  f("0100000 ????? ????? 101 ????? 01100 11", sra    , R    , R(rd) = (sword_t)src1 >> (src2 & 0x1f)                    )  \
+  f("0000000 ????? ????? 110 ????? 01100 11", or     , R    , R(rd) = src1 | src2                                       )  \
+  f("0000000 ????? ????? 111 ????? 01100 11", and    , R    , R(rd) = src1 & src2                                       )  \
+                                                                                                                           \
+  /* fence, a no-op since memory accesses are in order, and the Zifencei extension */                                      \
+  f("??????? ????? ????? 000 ????? 00011 11", fence  , N    ,                                                           )  \
+  f("??????? ????? ????? 001 ????? 00011 11", fence_i, N    , pmem_code_flush()                                         )  \
+                                                                                                                           \
+  /* M extension */                                                                                                        \
+  f("0000001 ????? ????? 000 ????? 01100 11", mul    , R    , R(rd) = src1 * src2                                       )  \
+  f("0000001 ????? ????? 001 ????? 01100 11", mulh   , R    , R(rd) = ((int64_t)(int32_t)src1 * (int32_t)src2 >> 32)    )  \
+  f("0000001 ????? ????? 010 ????? 01100 11", mulhsu , R    , R(rd) = ((int64_t)(int32_t)src1 * (uint64_t)src2) >> 32   )  \
+  f("0000001 ????? ????? 011 ????? 01100 11", mulhu  , R    , R(rd) = ((uint64_t)src1 * (uint64_t)src2) >> 32           )  \
+  f("0000001 ????? ????? 100 ????? 01100 11", div    , R    , R(rd) = (int32_t)src1 / (int32_t)src2                     )  \
+  f("0000001 ????? ????? 101 ????? 01100 11", divu   , R    , R(rd) = src1 / src2                                       )  \
+  f("0000001 ????? ????? 110 ????? 01100 11", rem    , R    , R(rd) = (int32_t)src1 % (int32_t)src2                     )  \
+  f("0000001 ????? ????? 111 ????? 01100 11", remu   , R    , R(rd) = src1 % src2                                       )  \
+                                                                                                                           \
+  /* Zba extension */                                                                                                      \
+  f("0010000 ????? ????? 010 ????? 01100 11", sh1add , R    , R(rd) = ZB((src1 << 1) + src2)                            )  \
+  f("0010000 ????? ????? 100 ????? 01100 11", sh2add , R    , R(rd) = ZB((src1 << 2) + src2)                            )  \
+  f("0010000 ????? ????? 110 ????? 01100 11", sh3add , R    , R(rd) = ZB((src1 << 3) + src2)                            )  \
+                                                                                                                           \
+  /* Zbb extension */                                                                                                      \
+  f("0100000 ????? ????? 111 ????? 01100 11", andn   , R    , R(rd) = ZB(src1 & ~src2)                                  )  \
+  f("0100000 ????? ????? 110 ????? 01100 11", orn    , R    , R(rd) = ZB(src1 | ~src2)                                  )  \
+  f("0100000 ????? ????? 100 ????? 01100 11", xnor   , R    , R(rd) = ZB(~(src1 ^ src2))                                )  \
+  f("0110000 00000 ????? 001 ????? 00100 11", clz    , R    , R(rd) = ZB(zb_clz(src1))                                  )  \
+  f("0110000 00001 ????? 001 ????? 00100 11", ctz    , R    , R(rd) = ZB(zb_ctz(src1))                                  )  \
+  f("0110000 00010 ????? 001 ????? 00100 11", cpop   , R    , R(rd) = ZB(__builtin_popcount(src1))                      )  \
+  f("0000101 ????? ????? 110 ????? 01100 11", max    , R    , R(rd) = ZB(((sword_t)src1 > (sword_t)src2) ? src1 : src2) )  \
+  f("0000101 ????? ????? 111 ????? 01100 11", maxu   , R    , R(rd) = ZB((src1 > src2) ? src1 : src2)                   )  \
+  f("0000101 ????? ????? 100 ????? 01100 11", min    , R    , R(rd) = ZB(((sword_t)src1 < (sword_t)src2) ? src1 : src2) )  \
+  f("0000101 ????? ????? 101 ????? 01100 11", minu   , R    , R(rd) = ZB((src1 < src2) ? src1 : src2)                   )  \
+  f("0110000 00100 ????? 001 ????? 00100 11", sext_b , R    , R(rd) = ZB(SEXT(src1, 8))                                 )  \
+  f("0110000 00101 ????? 001 ????? 00100 11", sext_h , R    , R(rd) = ZB(SEXT(src1, 16))                                )  \
+  f("0000100 00000 ????? 100 ????? 01100 11", zext_h , R    , R(rd) = ZB(src1 & 0xffff)                                 )  \
+  f("0110000 ????? ????? 001 ????? 01100 11", rol    , R    , R(rd) = ZB(zb_rol(src1, src2))                            )  \
+  f("0110000 ????? ????? 101 ????? 01100 11", ror    , R    , R(rd) = ZB(zb_ror(src1, src2))                            )  \
+  f("0110000 ????? ????? 101 ????? 00100 11", rori   , I    , R(rd) = ZB(zb_ror(src1, imm))                             )  \
+  f("0010100 00111 ????? 101 ????? 00100 11", orc_b  , R    , R(rd) = ZB(zb_orc_b(src1))                                )  \
+  f("0110100 11000 ????? 101 ????? 00100 11", rev8   , R    , R(rd) = ZB(__builtin_bswap32(src1))                       )  \
+                                                                                                                           \
+  /* Zbs extension */                                                                                                      \
+  f("0100100 ????? ????? 001 ????? 01100 11", bclr   , R    , R(rd) = ZB(src1 & ~(1u << (src2 & 0x1f)))                 )  \
+  f("0100100 ????? ????? 001 ????? 00100 11", bclri  , I    , R(rd) = ZB(src1 & ~(1u << (imm & 0x1f)))                  )  \
+  f("0100100 ????? ????? 101 ????? 01100 11", bext   , R    , R(rd) = ZB((src1 >> (src2 & 0x1f)) & 1)                   )  \
+  f("0100100 ????? ????? 101 ????? 00100 11", bexti  , I    , R(rd) = ZB((src1 >> (imm & 0x1f)) & 1)                    )  \
+  f("0110100 ????? ????? 001 ????? 01100 11", binv   , R    , R(rd) = ZB(src1 ^ (1u << (src2 & 0x1f)))                  )  \
+  f("0110100 ????? ????? 001 ????? 00100 11", binvi  , I    , R(rd) = ZB(src1 ^ (1u << (imm & 0x1f)))                   )  \
+  f("0010100 ????? ????? 001 ????? 01100 11", bset   , R    , R(rd) = ZB(src1 | (1u << (src2 & 0x1f)))                  )  \
+  f("0010100 ????? ????? 001 ????? 00100 11", bseti  , I    , R(rd) = ZB(src1 | (1u << (imm & 0x1f)))                   )  \
+                                                                                                                           \
+  /* A extension */                                                                                                        \
+  f("00010?? 00000 ????? 010 ????? 01011 11", lr_w     , R , R(rd) = SEXT(amo_lr(src1), 32)                            )  \
+  f("00011?? ????? ????? 010 ????? 01011 11", sc_w     , R , R(rd) = amo_sc(src1, src2)                                )  \
+  f("00001?? ????? ????? 010 ????? 01011 11", amoswap_w, R , R(rd) = SEXT(amo_rmw(AMO_SWAP, src1, src2), 32)           )  \
+  f("00000?? ????? ????? 010 ????? 01011 11", amoadd_w , R , R(rd) = SEXT(amo_rmw(AMO_ADD , src1, src2), 32)           )  \
+  f("00100?? ????? ????? 010 ????? 01011 11", amoxor_w , R , R(rd) = SEXT(amo_rmw(AMO_XOR , src1, src2), 32)           )  \
+  f("01100?? ????? ????? 010 ????? 01011 11", amoand_w , R , R(rd) = SEXT(amo_rmw(AMO_AND , src1, src2), 32)           )  \
+  f("01000?? ????? ????? 010 ????? 01011 11", amoor_w  , R , R(rd) = SEXT(amo_rmw(AMO_OR  , src1, src2), 32)           )  \
+  f("10000?? ????? ????? 010 ????? 01011 11", amomin_w , R , R(rd) = SEXT(amo_rmw(AMO_MIN , src1, src2), 32)           )  \
+  f("10100?? ????? ????? 010 ????? 01011 11", amomax_w , R , R(rd) = SEXT(amo_rmw(AMO_MAX , src1, src2), 32)           )  \
+  f("11000?? ????? ????? 010 ????? 01011 11", amominu_w, R , R(rd) = SEXT(amo_rmw(AMO_MINU, src1, src2), 32)           )  \
+  f("11100?? ????? ????? 010 ????? 01011 11", amomaxu_w, R , R(rd) = SEXT(amo_rmw(AMO_MAXU, src1, src2), 32)           )  \
+                                                                                                                           \
+  /* V extension, see local-include/vector.h */                                                                            \
+  f("0?????? ????? ????? 111 ????? 10101 11", vsetvli   , I , R(rd) = vec_set(s, src1, imm & 0x7ff, false)              )  \
+  f("11????? ????? ????? 111 ????? 10101 11", vsetivli  , I , R(rd) = vec_set(s, s->isa.rs1, imm & 0x3ff, true)         )  \
+  f("1000000 ????? ????? 111 ????? 10101 11", vsetvl    , R , R(rd) = vec_set(s, src1, src2, false)                     )  \
+  f("000000? 00000 ????? 000 ????? 00001 11", vle8_v    , R , vec_load(s, 1, VMEM_UNIT, 0)                              )  \
+  f("000000? 00000 ????? 101 ????? 00001 11", vle16_v   , R , vec_load(s, 2, VMEM_UNIT, 0)                              )  \
+  f("000000? 00000 ????? 110 ????? 00001 11", vle32_v   , R , vec_load(s, 4, VMEM_UNIT, 0)                              )  \
+  f("000010? ????? ????? 000 ????? 00001 11", vlse8_v   , R , vec_load(s, 1, VMEM_STRIDE, src2)                         )  \
+  f("000010? ????? ????? 101 ????? 00001 11", vlse16_v  , R , vec_load(s, 2, VMEM_STRIDE, src2)                         )  \
+  f("000010? ????? ????? 110 ????? 00001 11", vlse32_v  , R , vec_load(s, 4, VMEM_STRIDE, src2)                         )  \
+  f("000001? ????? ????? 000 ????? 00001 11", vluxei8_v , R , vec_load(s, 1, VMEM_INDEX, 0)                             )  \
+  f("000001? ????? ????? 101 ????? 00001 11", vluxei16_v, R , vec_load(s, 2, VMEM_INDEX, 0)                             )  \
+  f("000001? ????? ????? 110 ????? 00001 11", vluxei32_v, R , vec_load(s, 4, VMEM_INDEX, 0)                             )  \
+  f("000011? ????? ????? 000 ????? 00001 11", vloxei8_v , R , vec_load(s, 1, VMEM_INDEX, 0)                             )  \
+  f("000011? ????? ????? 101 ????? 00001 11", vloxei16_v, R , vec_load(s, 2, VMEM_INDEX, 0)                             )  \
+  f("000011? ????? ????? 110 ????? 00001 11", vloxei32_v, R , vec_load(s, 4, VMEM_INDEX, 0)                             )  \
+  f("000000? 00000 ????? 000 ????? 01001 11", vse8_v    , R , vec_store(s, 1, VMEM_UNIT, 0)                             )  \
+  f("000000? 00000 ????? 101 ????? 01001 11", vse16_v   , R , vec_store(s, 2, VMEM_UNIT, 0)                             )  \
+  f("000000? 00000 ????? 110 ????? 01001 11", vse32_v   , R , vec_store(s, 4, VMEM_UNIT, 0)                             )  \
+  f("000010? ????? ????? 000 ????? 01001 11", vsse8_v   , R , vec_store(s, 1, VMEM_STRIDE, src2)                        )  \
+  f("000010? ????? ????? 101 ????? 01001 11", vsse16_v  , R , vec_store(s, 2, VMEM_STRIDE, src2)                        )  \
+  f("000010? ????? ????? 110 ????? 01001 11", vsse32_v  , R , vec_store(s, 4, VMEM_STRIDE, src2)                        )  \
+  f("000001? ????? ????? 000 ????? 01001 11", vsuxei8_v , R , vec_store(s, 1, VMEM_INDEX, 0)                            )  \
+  f("000001? ????? ????? 101 ????? 01001 11", vsuxei16_v, R , vec_store(s, 2, VMEM_INDEX, 0)                            )  \
+  f("000001? ????? ????? 110 ????? 01001 11", vsuxei32_v, R , vec_store(s, 4, VMEM_INDEX, 0)                            )  \
+  f("000011? ????? ????? 000 ????? 01001 11", vsoxei8_v , R , vec_store(s, 1, VMEM_INDEX, 0)                            )  \
+  f("000011? ????? ????? 101 ????? 01001 11", vsoxei16_v, R , vec_store(s, 2, VMEM_INDEX, 0)                            )  \
+  f("000011? ????? ????? 110 ????? 01001 11", vsoxei32_v, R , vec_store(s, 4, VMEM_INDEX, 0)                            )  \
+  f("000000? ????? ????? 000 ????? 10101 11", vadd_vv   , R , vec_arith(s, VOP_ADD, VV)                                 )  \
+  f("000000? ????? ????? 100 ????? 10101 11", vadd_vx   , R , vec_arith(s, VOP_ADD, VX)                                 )  \
+  f("000000? ????? ????? 011 ????? 10101 11", vadd_vi   , R , vec_arith(s, VOP_ADD, VI)                                 )  \
+  f("000010? ????? ????? 000 ????? 10101 11", vsub_vv   , R , vec_arith(s, VOP_SUB, VV)                                 )  \
+  f("000010? ????? ????? 100 ????? 10101 11", vsub_vx   , R , vec_arith(s, VOP_SUB, VX)                                 )  \
+  f("000011? ????? ????? 100 ????? 10101 11", vrsub_vx  , R , vec_arith(s, VOP_RSUB, VX)                                )  \
+  f("000011? ????? ????? 011 ????? 10101 11", vrsub_vi  , R , vec_arith(s, VOP_RSUB, VI)                                )  \
+  f("000100? ????? ????? 000 ????? 10101 11", vminu_vv  , R , vec_arith(s, VOP_MINU, VV)                                )  \
+  f("000100? ????? ????? 100 ????? 10101 11", vminu_vx  , R , vec_arith(s, VOP_MINU, VX)                                )  \
+  f("000101? ????? ????? 000 ????? 10101 11", vmin_vv   , R , vec_arith(s, VOP_MIN, VV)                                 )  \
+  f("000101? ????? ????? 100 ????? 10101 11", vmin_vx   , R , vec_arith(s, VOP_MIN, VX)                                 )  \
+  f("000110? ????? ????? 000 ????? 10101 11", vmaxu_vv  , R , vec_arith(s, VOP_MAXU, VV)                                )  \
+  f("000110? ????? ????? 100 ????? 10101 11", vmaxu_vx  , R , vec_arith(s, VOP_MAXU, VX)                                )  \
+  f("000111? ????? ????? 000 ????? 10101 11", vmax_vv   , R , vec_arith(s, VOP_MAX, VV)                                 )  \
+  f("000111? ????? ????? 100 ????? 10101 11", vmax_vx   , R , vec_arith(s, VOP_MAX, VX)                                 )  \
+  f("001001? ????? ????? 000 ????? 10101 11", vand_vv   , R , vec_arith(s, VOP_AND, VV)                                 )  \
+  f("001001? ????? ????? 100 ????? 10101 11", vand_vx   , R , vec_arith(s, VOP_AND, VX)                                 )  \
+  f("001001? ????? ????? 011 ????? 10101 11", vand_vi   , R , vec_arith(s, VOP_AND, VI)                                 )  \
+  f("001010? ????? ????? 000 ????? 10101 11", vor_vv    , R , vec_arith(s, VOP_OR, VV)                                  )  \
+  f("001010? ????? ????? 100 ????? 10101 11", vor_vx    , R , vec_arith(s, VOP_OR, VX)                                  )  \
+  f("001010? ????? ????? 011 ????? 10101 11", vor_vi    , R , vec_arith(s, VOP_OR, VI)                                  )  \
+  f("001011? ????? ????? 000 ????? 10101 11", vxor_vv   , R , vec_arith(s, VOP_XOR, VV)                                 )  \
+  f("001011? ????? ????? 100 ????? 10101 11", vxor_vx   , R , vec_arith(s, VOP_XOR, VX)                                 )  \
+  f("001011? ????? ????? 011 ????? 10101 11", vxor_vi   , R , vec_arith(s, VOP_XOR, VI)                                 )  \
+  f("010111? ????? ????? 000 ????? 10101 11", vmerge_vv , R , vec_arith(s, VOP_MERGE, VV)                               )  \
+  f("010111? ????? ????? 100 ????? 10101 11", vmerge_vx , R , vec_arith(s, VOP_MERGE, VX)                               )  \
+  f("010111? ????? ????? 011 ????? 10101 11", vmerge_vi , R , vec_arith(s, VOP_MERGE, VI)                               )  \
+  f("011000? ????? ????? 000 ????? 10101 11", vmseq_vv  , R , vec_arith(s, VOP_MSEQ, VV)                                )  \
+  f("011000? ????? ????? 100 ????? 10101 11", vmseq_vx  , R , vec_arith(s, VOP_MSEQ, VX)                                )  \
+  f("011000? ????? ????? 011 ????? 10101 11", vmseq_vi  , R , vec_arith(s, VOP_MSEQ, VI)                                )  \
+  f("011001? ????? ????? 000 ????? 10101 11", vmsne_vv  , R , vec_arith(s, VOP_MSNE, VV)                                )  \
+  f("011001? ????? ????? 100 ????? 10101 11", vmsne_vx  , R , vec_arith(s, VOP_MSNE, VX)                                )  \
+  f("011001? ????? ????? 011 ????? 10101 11", vmsne_vi  , R , vec_arith(s, VOP_MSNE, VI)                                )  \
+  f("011010? ????? ????? 000 ????? 10101 11", vmsltu_vv , R , vec_arith(s, VOP_MSLTU, VV)                               )  \
+  f("011010? ????? ????? 100 ????? 10101 11", vmsltu_vx , R , vec_arith(s, VOP_MSLTU, VX)                               )  \
+  f("011011? ????? ????? 000 ????? 10101 11", vmslt_vv  , R , vec_arith(s, VOP_MSLT, VV)                                )  \
+  f("011011? ????? ????? 100 ????? 10101 11", vmslt_vx  , R , vec_arith(s, VOP_MSLT, VX)                                )  \
+  f("011100? ????? ????? 000 ????? 10101 11", vmsleu_vv , R , vec_arith(s, VOP_MSLEU, VV)                               )  \
+  f("011100? ????? ????? 100 ????? 10101 11", vmsleu_vx , R , vec_arith(s, VOP_MSLEU, VX)                               )  \
+  f("011100? ????? ????? 011 ????? 10101 11", vmsleu_vi , R , vec_arith(s, VOP_MSLEU, VI)                               )  \
+  f("011101? ????? ????? 000 ????? 10101 11", vmsle_vv  , R , vec_arith(s, VOP_MSLE, VV)                                )  \
+  f("011101? ????? ????? 100 ????? 10101 11", vmsle_vx  , R , vec_arith(s, VOP_MSLE, VX)                                )  \
+  f("011101? ????? ????? 011 ????? 10101 11", vmsle_vi  , R , vec_arith(s, VOP_MSLE, VI)                                )  \
+  f("011110? ????? ????? 100 ????? 10101 11", vmsgtu_vx , R , vec_arith(s, VOP_MSGTU, VX)                               )  \
+  f("011110? ????? ????? 011 ????? 10101 11", vmsgtu_vi , R , vec_arith(s, VOP_MSGTU, VI)                               )  \
+  f("011111? ????? ????? 100 ????? 10101 11", vmsgt_vx  , R , vec_arith(s, VOP_MSGT, VX)                                )  \
+  f("011111? ????? ????? 011 ????? 10101 11", vmsgt_vi  , R , vec_arith(s, VOP_MSGT, VI)                                )  \
+  f("100101? ????? ????? 000 ????? 10101 11", vsll_vv   , R , vec_arith(s, VOP_SLL, VV)                                 )  \
+  f("100101? ????? ????? 100 ????? 10101 11", vsll_vx   , R , vec_arith(s, VOP_SLL, VX)                                 )  \
+  f("100101? ????? ????? 011 ????? 10101 11", vsll_vi   , R , vec_arith(s, VOP_SLL, VIU)                                )  \
+  f("101000? ????? ????? 000 ????? 10101 11", vsrl_vv   , R , vec_arith(s, VOP_SRL, VV)                                 )  \
+  f("101000? ????? ????? 100 ????? 10101 11", vsrl_vx   , R , vec_arith(s, VOP_SRL, VX)                                 )  \
+  f("101000? ????? ????? 011 ????? 10101 11", vsrl_vi   , R , vec_arith(s, VOP_SRL, VIU)                                )  \
+  f("101001? ????? ????? 000 ????? 10101 11", vsra_vv   , R , vec_arith(s, VOP_SRA, VV)                                 )  \
+  f("101001? ????? ????? 100 ????? 10101 11", vsra_vx   , R , vec_arith(s, VOP_SRA, VX)                                 )  \
+  f("101001? ????? ????? 011 ????? 10101 11", vsra_vi   , R , vec_arith(s, VOP_SRA, VIU)                                )  \
+  f("100101? ????? ????? 010 ????? 10101 11", vmul_vv   , R , vec_arith(s, VOP_MUL, VV)                                 )  \
+  f("100101? ????? ????? 110 ????? 10101 11", vmul_vx   , R , vec_arith(s, VOP_MUL, VX)                                 )  \
+  f("100111? ????? ????? 010 ????? 10101 11", vmulh_vv  , R , vec_arith(s, VOP_MULH, VV)                                )  \
+  f("100111? ????? ????? 110 ????? 10101 11", vmulh_vx  , R , vec_arith(s, VOP_MULH, VX)                                )  \
+  f("100100? ????? ????? 010 ????? 10101 11", vmulhu_vv , R , vec_arith(s, VOP_MULHU, VV)                               )  \
+  f("100100? ????? ????? 110 ????? 10101 11", vmulhu_vx , R , vec_arith(s, VOP_MULHU, VX)                               )  \
+  f("101101? ????? ????? 010 ????? 10101 11", vmacc_vv  , R , vec_arith(s, VOP_MACC, VV)                                )  \
+  f("101101? ????? ????? 110 ????? 10101 11", vmacc_vx  , R , vec_arith(s, VOP_MACC, VX)                                )  \
+  f("000000? ????? ????? 010 ????? 10101 11", vredsum   , R , vec_red(s, VRED_SUM)                                      )  \
+  f("000001? ????? ????? 010 ????? 10101 11", vredand   , R , vec_red(s, VRED_AND)                                      )  \
+  f("000010? ????? ????? 010 ????? 10101 11", vredor    , R , vec_red(s, VRED_OR)                                       )  \
+  f("000011? ????? ????? 010 ????? 10101 11", vredxor   , R , vec_red(s, VRED_XOR)                                      )  \
+  f("000100? ????? ????? 010 ????? 10101 11", vredminu  , R , vec_red(s, VRED_MINU)                                     )  \
+  f("000101? ????? ????? 010 ????? 10101 11", vredmin   , R , vec_red(s, VRED_MIN)                                      )  \
+  f("000110? ????? ????? 010 ????? 10101 11", vredmaxu  , R , vec_red(s, VRED_MAXU)                                     )  \
+  f("000111? ????? ????? 010 ????? 10101 11", vredmax   , R , vec_red(s, VRED_MAX)                                      )  \
+  f("0100001 ????? 00000 010 ????? 10101 11", vmv_x_s   , R , R(rd) = vec_mv_x_s(s)                                     )  \
+  f("0100001 00000 ????? 110 ????? 10101 11", vmv_s_x   , R , vec_mv_s_x(s, src1)                                       )  \
+  f("010100? 00000 10001 010 ????? 10101 11", vid_v     , R , vec_id(s)                                                 )  \
+                                                                                                                           \
+  /* Zicsr extension and supervisor instructions */                                                                        \
+  f("??????? ????? ????? 001 ????? 11100 11", csrrw  , I    , R(rd) = csr_access(s, CSR_OP_W, src1)                     )  \
+  f("??????? ????? ????? 010 ????? 11100 11", csrrs  , I    , R(rd) = csr_access(s, CSR_OP_S, src1)                     )  \
+  f("??????? ????? ????? 011 ????? 11100 11", csrrc  , I    , R(rd) = csr_access(s, CSR_OP_C, src1)                     )  \
+  f("??????? ????? ????? 101 ????? 11100 11", csrrwi , I    , R(rd) = csr_access(s, CSR_OP_W, s->isa.rs1)               )  \
+  f("??????? ????? ????? 110 ????? 11100 11", csrrsi , I    , R(rd) = csr_access(s, CSR_OP_S, s->isa.rs1)               )  \
+  f("??????? ????? ????? 111 ????? 11100 11", csrrci , I    , R(rd) = csr_access(s, CSR_OP_C, s->isa.rs1)               )  \
+  f("0001001 ????? ????? 000 00000 11100 11", sfence_vma, R , mmu_sfence_vma(s->isa.rs1 != 0, src1, s->isa.rs2 != 0, src2))  \
+  f("0000000 00000 00000 000 00000 11100 11", ecall  , N    , s->dnpc = isa_raise_intr(EXC_ECALL_M, s->pc)              )  \
+  f("0011000 00010 00000 000 00000 11100 11", mret   , N    , s->dnpc = intr_mret()                                     )  \
+  f("0001000 00101 00000 000 00000 11100 11", wfi    , N    ,                                                           )  \
+                                                                                                                           \
+  /* R(10) is $a0 */                                                                                                       \
+  f("0000000 00001 00000 000 00000 11100 11", ebreak , N    , NEMUTRAP(s->pc, R(10))                                    )  \
+  f("??????? ????? ????? ??? ????? ????? ??", inv    , N    , INV(s->pc)                                                )
+
+#define def_INSTR_ID(pattern, name, ...) concat(INSTR_, name),
+enum { MAP(INSTR_LIST, def_INSTR_ID) NR_INSTR };
+
+// instructions which may change the control flow or the state of NEMU,
+// a basic block ends after any of them
+#define INSTR_BLOCK_END_LIST(f) \
+  f(jal) f(jalr) f(beq) f(bne) f(blt) f(bge) f(bltu) f(bgeu) \
+  f(csrrw) f(csrrs) f(csrrc) f(csrrwi) f(csrrsi) f(csrrci) f(sfence_vma) \
+  f(ecall) f(mret) f(fence_i) f(ebreak) f(inv)
+
+// instructions which access memory, and may raise a page fault in the
+// middle of a block
+#define INSTR_MEM_LIST(f) \
+  f(lb) f(lh) f(lw) f(lbu) f(lhu) f(sb) f(sh) f(sw) \
+  f(lr_w) f(sc_w) f(amoswap_w) f(amoadd_w) f(amoxor_w) f(amoand_w) f(amoor_w) \
+  f(amomin_w) f(amomax_w) f(amominu_w) f(amomaxu_w) \
+  f(vle8_v) f(vle16_v) f(vle32_v) f(vlse8_v) f(vlse16_v) f(vlse32_v) \
+  f(vluxei8_v) f(vluxei16_v) f(vluxei32_v) f(vloxei8_v) f(vloxei16_v) \
+  f(vloxei32_v) f(vse8_v) f(vse16_v) f(vse32_v) f(vsse8_v) f(vsse16_v) \
+  f(vsse32_v) f(vsuxei8_v) f(vsuxei16_v) f(vsuxei32_v) f(vsoxei8_v) \
+  f(vsoxei16_v) f(vsoxei32_v)
+
+// instructions which access CSRs, and may read the instruction counters
+#define INSTR_CSR_LIST(f) \
+  f(csrrw) f(csrrs) f(csrrc) f(csrrwi) f(csrrsi) f(csrrci)
+
+#endif
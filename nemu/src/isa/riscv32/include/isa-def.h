@@ -21,15 +21,34 @@
 typedef struct {
   word_t gpr[MUXDEF(CONFIG_RVE, 16, 32)];
   vaddr_t pc;
+  word_t satp;
+  // machine-mode CSRs, see local-include/csr.h
+  word_t mstatus, mie, mip, mtvec, mscratch, mepc, mcause, mtval;
+#ifdef CONFIG_RV_V
+  word_t vstart, vl, vtype;
+  // v0 to v31, followed by the bytes read beyond v31 by the host vector
+  // kernels in vector.c
+  uint8_t vr[32 * (CONFIG_RV_VLEN / 8) + 32] __attribute__((aligned(32)));
+#endif
 } MUXDEF(CONFIG_RV64, riscv64_CPU_state, riscv32_CPU_state);
 
 // decode
+struct Decode;
 typedef struct {
   union {
     uint32_t val;
   } inst;
+  void (*EHelper)(struct Decode *s); // execution helper of the instruction
+  uint16_t id; // INSTR_xxx in isa-all-instr.h
+  uint8_t rd, rs1, rs2;
+  word_t imm;
 } MUXDEF(CONFIG_RV64, riscv64_ISADecodeInfo, riscv32_ISADecodeInfo);
 
+#ifdef CONFIG_RV_SV32
+// translate when satp.MODE is Sv32, in all privilege modes
+#define isa_mmu_check(vaddr, len, type) ((cpu.satp >> 31) ? MMU_TRANSLATE : MMU_DIRECT)
+#else
 #define isa_mmu_check(vaddr, len, type) (MMU_DIRECT)
+#endif
 
 #endif
@@ -15,6 +15,7 @@
 
 #include <isa.h>
 #include <memory/paddr.h>
+#include "local-include/csr.h"
 
 // this is not consistent with uint8_t
 // but it is ok since we do not access the array directly
@@ -32,7 +33,21 @@ static void restart() {
 
   /* The zero register is always 0. */
   cpu.gpr[0] = 0;
+
+  /* Traps go to M-mode, where the hart starts. */
+  cpu.mstatus = MSTATUS_MPP;
+
+  IFDEF(CONFIG_DECODE_CACHE, isa_dcache_flush());
+}
+
+#ifdef CONFIG_SMP
+// hart `id' starts with its ID in a0 and the number of harts in a1
+void isa_hart_init(int id) {
+  restart();
+  cpu.gpr[10] = id;
+  cpu.gpr[11] = CONFIG_NR_HART;
 }
+#endif
 
 void init_isa() {
   /* Load built-in image. */
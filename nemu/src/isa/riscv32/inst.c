@@ -14,120 +14,413 @@
 ***************************************************************************************/
 
 #include "local-include/reg.h"
+#include "local-include/csr.h"
+#include "local-include/amo.h"
+#include "local-include/bitmanip.h"
+#include "local-include/vector.h"
+#include "local-include/rvc.h"
+#include "local-include/operand.h"
+#include <isa-all-instr.h>
 #include <cpu/cpu.h>
 #include <cpu/ifetch.h>
 #include <cpu/decode.h>
+#include <memory/paddr.h>
+#include <cpu/block.h>
 
 #define R(i) gpr(i)
 #define Mr vaddr_read
 #define Mw vaddr_write
+// length of the instruction `inst' in bytes
+#define ILEN(inst) MUXDEF(CONFIG_RVC, (RVC_IS_COMPRESSED(inst) ? 2 : 4), 4)
 
-enum {
-  TYPE_R,
-  TYPE_I,
-  TYPE_S,
-  TYPE_B,
-  TYPE_U,
-  TYPE_J,
-  TYPE_N, // none
-};
-
-#define src1R() do { *src1 = R(rs1); } while (0)
-#define src2R() do { *src2 = R(rs2); } while (0)
-#define immI() do { *imm = SEXT(BITS(i, 31, 20), 12); } while(0)
-#define immS() do { *imm = (SEXT(BITS(i, 31, 25), 7) << 5) | BITS(i, 11, 7); } while(0)
-#define immB() do { *imm = (SEXT(BITS(i, 31, 31), 1) << 12 | BITS(i, 7, 7) << 11 \
-                            | BITS(i, 30, 25) << 5 | BITS(i, 11, 8) << 1); } while(0)
-#define immU() do { *imm = SEXT(BITS(i, 31, 12), 20) << 12; } while(0)
-#define immJ() do { *imm = (SEXT(BITS(i, 31, 31), 1) << 20 | BITS(i, 19, 12) << 12 \
-                            | BITS(i, 20, 20) << 11 | BITS(i, 30, 21) << 1); } while(0)
-
-static void decode_operand(Decode *s, int *rd, word_t *src1, word_t *src2, word_t *imm, int type) {
-  uint32_t i = s->isa.inst.val;
-  int rs1 = BITS(i, 19, 15);
-  int rs2 = BITS(i, 24, 20);
-  *rd     = BITS(i, 11, 7);
-  switch (type) {
-    case TYPE_R: src1R(); src2R();         break;
-    case TYPE_I: src1R();          immI(); break;
-    case TYPE_S: src1R(); src2R(); immS(); break;
-    case TYPE_B: src1R(); src2R(); immB(); break;
-    case TYPE_U:                   immU(); break;
-    case TYPE_J:                   immJ(); break;
+// extract the operands of an instruction of `type' known at compile time
+#define decode_operand(s, type) do { \
+  Operand op = concat(operand_, type)((s)->isa.inst.val); \
+  (s)->isa.rd = op.rd; \
+  (s)->isa.rs1 = op.rs1; \
+  (s)->isa.rs2 = op.rs2; \
+  (s)->isa.imm = op.imm; \
+} while (0)
+
+// --- execution helpers ---
+#define def_EHelper(pattern, name, type, ... /* execute body */ ) \
+  static void concat(exec_, name) (Decode *s) { \
+    __attribute__((unused)) int rd = s->isa.rd; \
+    __attribute__((unused)) word_t src1 = R(s->isa.rs1); \
+    __attribute__((unused)) word_t src2 = R(s->isa.rs2); \
+    __attribute__((unused)) word_t imm = s->isa.imm; \
+    __VA_ARGS__ ; \
+    R(0) = 0; /* reset $zero to 0 */ \
   }
-}
 
-static int decode_exec(Decode *s) {
-  int rd = 0;
-  word_t src1 = 0, src2 = 0, imm = 0;
-  s->dnpc = s->snpc;
+MAP(INSTR_LIST, def_EHelper)
 
 #define INSTPAT_INST(s) ((s)->isa.inst.val)
 #define INSTPAT_MATCH(s, name, type, ... /* execute body */ ) { \
-  decode_operand(s, &rd, &src1, &src2, &imm, concat(TYPE_, type)); \
-  __VA_ARGS__ ; \
+  decode_operand(s, type); \
+  s->isa.id = concat(INSTR_, name); \
+  s->isa.EHelper = concat(exec_, name); \
 }
 
+#if !defined(CONFIG_DECODE_TREE) || defined(CONFIG_DECODE_TREE_CHECK)
+static void decode_linear(Decode *s) {
+#define INSTPAT_ITEM(pattern, ...) INSTPAT(pattern, __VA_ARGS__);
   INSTPAT_START();
-  INSTPAT("??????? ????? ????? ??? ????? 01101 11", lui    , U    , R(rd) = imm                                               );
-  INSTPAT("??????? ????? ????? ??? ????? 00101 11", auipc  , U    , R(rd) = s->pc + imm                                       );
-  INSTPAT("??????? ????? ????? ??? ????? 11011 11", jal    , J    , R(rd) = s->snpc; s->dnpc = s->pc + imm                    );
-  INSTPAT("??????? ????? ????? 000 ????? 11001 11", jalr   , I    , R(rd) = s->snpc; s->dnpc = src1 + imm                     );
-  INSTPAT("??????? ????? ????? 000 ????? 11000 11", beq    , B    , if (src1 == src2) s->dnpc = s->pc + imm                   );
-  INSTPAT("??????? ????? ????? 001 ????? 11000 11", bne    , B    , if (src1 != src2) s->dnpc = s->pc + imm                    );
-  INSTPAT("??????? ????? ????? 100 ????? 11000 11", blt    , B    , if ((sword_t)src1 <  (sword_t)src2) s->dnpc = s->pc + imm );
-  INSTPAT("??????? ????? ????? 101 ????? 11000 11", bge    , B    , if ((sword_t)src1 >= (sword_t)src2) s->dnpc = s->pc + imm );
-  INSTPAT("??????? ????? ????? 110 ????? 11000 11", bltu   , B    , if (src1 <  src2) s->dnpc = s->pc + imm                   );
-  INSTPAT("??????? ????? ????? 111 ????? 11000 11", bgeu   , B    , if (src1 >= src2) s->dnpc = s->pc + imm                   );
-  INSTPAT("??????? ????? ????? 000 ????? 00000 11", lb     , I    , R(rd) = SEXT(Mr(src1 + imm, 1), 8)                        );
-  INSTPAT("??????? ????? ????? 001 ????? 00000 11", lh     , I    , R(rd) = SEXT(Mr(src1 + imm, 2), 16)                       );
-  INSTPAT("??????? ????? ????? 010 ????? 00000 11", lw     , I    , R(rd) = SEXT(Mr(src1 + imm, 4), 32)                       );
-  INSTPAT("??????? ????? ????? 100 ????? 00000 11", lbu    , I    , R(rd) = Mr(src1 + imm, 1)                                 );
-  INSTPAT("??????? ????? ????? 101 ????? 00000 11", lhu    , I    , R(rd) = Mr(src1 + imm, 2)                                 );
-  INSTPAT("??????? ????? ????? 000 ????? 01000 11", sb     , S    , Mw(src1 + imm, 1, src2)                                   );
-  INSTPAT("??????? ????? ????? 001 ????? 01000 11", sh     , S    , Mw(src1 + imm, 2, src2)                                   );
-  INSTPAT("??????? ????? ????? 010 ????? 01000 11", sw     , S    , Mw(src1 + imm, 4, src2)                                   );
-  INSTPAT("??????? ????? ????? 000 ????? 00100 11", addi   , I    , R(rd) = src1 + imm                                        );
-  INSTPAT("??????? ????? ????? 010 ????? 00100 11", slti   , I    , R(rd) = ((sword_t)src1 < (sword_t)imm) ? 1 : 0            );
-  INSTPAT("??????? ????? ????? 011 ????? 00100 11", sltiu  , I    , R(rd) = (src1 < imm) ? 1 : 0                              );
-  INSTPAT("??????? ????? ????? 100 ????? 00100 11", xori   , I    , R(rd) = src1 ^ imm                                        );
-  INSTPAT("??????? ????? ????? 110 ????? 00100 11", ori    , I    , R(rd) = src1 | imm                                        );
-  INSTPAT("??????? ????? ????? 111 ????? 00100 11", andi   , I    , R(rd) = src1 & imm                                        );
-  INSTPAT("0000000 ????? ????? 001 ????? 00100 11", slli   , I    , R(rd) = src1 << (imm & 0x1f)                              );
-  INSTPAT("0000000 ????? ????? 101 ????? 00100 11", srli   , I    , R(rd) = src1 >> (imm & 0x1f)                              );
-  INSTPAT("0100000 ????? ????? 101 ????? 00100 11", srai   , I    , R(rd) = (sword_t)src1 >> (imm & 0x1f)                     );
-  INSTPAT("0000000 ????? ????? 000 ????? 01100 11", add    , R    , R(rd) = src1 + src2                                       );
-  INSTPAT("0100000 ????? ????? 000 ????? 01100 11", sub    , R    , R(rd) = src1 - src2                                       );
-  INSTPAT("0000000 ????? ????? 001 ????? 01100 11", sll    , R    , R(rd) = src1 << (src2 & 0x1f)                             );
-  INSTPAT("0000000 ????? ????? 010 ????? 01100 11", slt    , R    , R(rd) = ((sword_t)src1 < (sword_t)src2) ? 1 : 0           );
-  INSTPAT("0000000 ????? ????? 011 ????? 01100 11", sltu   , R    , R(rd) = (src1 < src2) ? 1 : 0                             );
-  INSTPAT("0000000 ????? ????? 100 ????? 01100 11", xor    , R    , R(rd) = src1 ^ src2                                       );
-  INSTPAT("0000000 ????? ????? 101 ????? 01100 11", srl    , R    , R(rd) = src1 >> (src2 & 0x1f)                             );
-  INSTPAT("0100000 ????? ????? 101 ????? 01100 11", sra    , R    , R(rd) = (sword_t)src1 >> (src2 & 0x1f)                    );
-  INSTPAT("0000000 ????? ????? 110 ????? 01100 11", or     , R    , R(rd) = src1 | src2                                       );
-  INSTPAT("0000000 ????? ????? 111 ????? 01100 11", and    , R    , R(rd) = src1 & src2                                       );
-
-  // M extension
-  INSTPAT("0000001 ????? ????? 000 ????? 01100 11", mul    , R    , R(rd) = src1 * src2                                       );
-  INSTPAT("0000001 ????? ????? 001 ????? 01100 11", mulh   , R    , R(rd) = ((int64_t)(int32_t)src1 * (int32_t)src2 >> 32)    );
-  INSTPAT("0000001 ????? ????? 010 ????? 01100 11", mulhsu , R    , R(rd) = ((int64_t)(int32_t)src1 * (uint64_t)src2) >> 32   );
-  INSTPAT("0000001 ????? ????? 011 ????? 01100 11", mulhu  , R    , R(rd) = ((uint64_t)src1 * (uint64_t)src2) >> 32           );
-  INSTPAT("0000001 ????? ????? 100 ????? 01100 11", div    , R    , R(rd) = (int32_t)src1 / (int32_t)src2                     );
-  INSTPAT("0000001 ????? ????? 101 ????? 01100 11", divu   , R    , R(rd) = src1 / src2                                       );
-  INSTPAT("0000001 ????? ????? 110 ????? 01100 11", rem    , R    , R(rd) = (int32_t)src1 % (int32_t)src2                     );
-  INSTPAT("0000001 ????? ????? 111 ????? 01100 11", remu   , R    , R(rd) = src1 % src2                                       );
-
-
-  INSTPAT("0000000 00001 00000 000 00000 11100 11", ebreak , N    , NEMUTRAP(s->pc, R(10))                                    ); // R(10) is $a0
-  INSTPAT("??????? ????? ????? ??? ????? ????? ??", inv    , N    , INV(s->pc)                                                );
+  MAP(INSTR_LIST, INSTPAT_ITEM)
   INSTPAT_END();
+}
+#endif
+
+#ifdef CONFIG_DECODE_TREE
+static void decode_tree(Decode *s) {
+  // a switch tree generated from INSTR_LIST by tools/gen-decode
+#include <generated/decode-tree.h>
+}
+#endif
+
+#ifdef CONFIG_FTRACE
+/* Calls and returns are told by the link registers x1 and x5, as the
+ * hints for return-address prediction in the ISA manual. The helpers
+ * with tracing replace the ones of jal and jalr at decoding, so that
+ * the other instructions pay nothing.
+ */
+#define IS_LINK(r) ((r) == 1 || (r) == 5)
+
+static void exec_jal_ftrace(Decode *s) {
+  exec_jal(s);
+  if (IS_LINK(s->isa.rd)) ftrace_call(s->pc, s->dnpc);
+  else ftrace_jump(s->pc, s->dnpc);
+}
 
-  R(0) = 0; // reset $zero to 0
+static void exec_jalr_ftrace(Decode *s) {
+  int rd = s->isa.rd, rs1 = s->isa.rs1;
+  exec_jalr(s);
+  if (IS_LINK(rd)) {
+    // a coroutine switch returns and calls at the same time
+    if (IS_LINK(rs1) && rs1 != rd) ftrace_ret(s->pc);
+    ftrace_call(s->pc, s->dnpc);
+  }
+  else if (IS_LINK(rs1)) ftrace_ret(s->pc);
+  else ftrace_jump(s->pc, s->dnpc);
+}
+#endif
 
+static int decode(Decode *s) {
+#ifdef CONFIG_RVC
+  // a compressed instruction is decoded as its 32-bit equivalent,
+  // while `inst.val' keeps the original one for tracing
+  uint32_t inst = s->isa.inst.val;
+  if (RVC_IS_COMPRESSED(inst)) s->isa.inst.val = rvc_expand(inst);
+#endif
+#ifdef CONFIG_DECODE_TREE
+  decode_tree(s);
+#ifdef CONFIG_DECODE_TREE_CHECK
+  Decode ref = *s;
+  decode_linear(&ref);
+  Assert(ref.isa.EHelper == s->isa.EHelper, "decode tree mismatches with "
+      "linear matching on inst = 0x%08x at pc = " FMT_WORD, s->isa.inst.val, s->pc);
+#endif
+#else
+  decode_linear(s);
+#endif
+#ifdef CONFIG_FTRACE
+  if (s->isa.id == INSTR_jal) s->isa.EHelper = exec_jal_ftrace;
+  else if (s->isa.id == INSTR_jalr) s->isa.EHelper = exec_jalr_ftrace;
+#endif
+  IFDEF(CONFIG_RVC, s->isa.inst.val = inst);
   return 0;
 }
 
-int isa_exec_once(Decode *s) {
+// Fetch the instruction at s->pc, and advance s->snpc over it.
+static inline void fetch(Decode *s) {
+#ifdef CONFIG_RVC
+  uint32_t inst;
+  if (likely((s->pc & 0x3) == 0)) {
+    inst = vaddr_ifetch(s->pc, 4);
+    if (RVC_IS_COMPRESSED(inst)) inst &= 0xffff;
+    s->snpc = s->pc + ILEN(inst);
+  } else {
+    // a 4-byte instruction here is misaligned and may cross a page,
+    // so it is fetched in halves
+    inst = inst_fetch(&s->snpc, 2);
+    if (!RVC_IS_COMPRESSED(inst)) inst |= inst_fetch(&s->snpc, 2) << 16;
+  }
+  s->isa.inst.val = inst;
+#else
   s->isa.inst.val = inst_fetch(&s->snpc, 4); // s->snpc will be pc + 4
-  return decode_exec(s);
+#endif
+}
+
+// --- decode cache ---
+#ifdef CONFIG_DECODE_CACHE
+#define DCACHE_SIZE CONFIG_DECODE_CACHE_SIZE
+static_assert((DCACHE_SIZE & (DCACHE_SIZE - 1)) == 0, "decode cache size should be a power of 2");
+
+// An entry is valid iff `pc` matches. Instructions are at least 2-byte
+// aligned, so an odd `pc` never hits.
+#define DCACHE_INVALID_PC ((vaddr_t)1)
+// alignment of instructions
+#define INST_ALIGN MUXDEF(CONFIG_RVC, 2, 4)
+
+typedef struct {
+  vaddr_t pc;
+  ISADecodeInfo isa;
+} DCacheEntry;
+
+static HART_LOCAL DCacheEntry dcache[DCACHE_SIZE];
+HART_LOCAL uint64_t g_nr_dcache_hit = 0;
+HART_LOCAL uint64_t g_nr_dcache_miss = 0;
+
+static inline DCacheEntry* dcache_entry(vaddr_t pc) {
+  return &dcache[(pc / INST_ALIGN) & (DCACHE_SIZE - 1)];
+}
+
+void isa_dcache_flush() {
+  int i;
+  for (i = 0; i < DCACHE_SIZE; i ++) {
+    dcache[i].pc = DCACHE_INVALID_PC;
+  }
+}
+
+// Called when a page containing cached instructions is written.
+// Since the cache is direct-mapped, only the entries of the
+// instructions overlapping with [addr, addr + len) need to be dropped.
+// A 4-byte instruction may start 2 bytes before `addr' with RVC.
+void isa_dcache_invalidate(paddr_t addr, int len) {
+  vaddr_t pc;
+  for (pc = (addr & ~(vaddr_t)(INST_ALIGN - 1)) - (4 - INST_ALIGN); pc < addr + len; pc += INST_ALIGN) {
+    DCacheEntry *e = dcache_entry(pc);
+    if (e->pc == pc) { e->pc = DCACHE_INVALID_PC; }
+  }
+}
+#endif
+
+#ifdef CONFIG_ENGINE_THREADED
+// --- threaded code ---
+/* Each handler executes its instruction and jumps to the handler of the
+ * next instruction in the block directly, without going back to the
+ * loop in execute().
+ */
+#define def_THandler(pattern, name, type, ... /* execute body */ ) \
+  concat(thr_, name): { \
+    Decode *s = &t->s; \
+    if (record_pos(concat(INSTR_, name))) thr_cur = t; \
+    __attribute__((unused)) int rd = s->isa.rd; \
+    __attribute__((unused)) word_t src1 = R(s->isa.rs1); \
+    __attribute__((unused)) word_t src2 = R(s->isa.rs2); \
+    __attribute__((unused)) word_t imm = s->isa.imm; \
+    s->dnpc = s->snpc; \
+    __VA_ARGS__ ; \
+    R(0) = 0; /* reset $zero to 0 */ \
+    t ++; \
+    goto *t->handler; \
+  }
+#define THANDLER_LABEL(pattern, name, ...) &&concat(thr_, name),
+
+/* An instruction accessing memory or CSRs records itself before it is
+ * executed, and the start of each block is recorded, so that
+ * isa_threaded_position() finds where a page fault is raised after the
+ * threaded code is left, or how many instructions are executed before
+ * a counter CSR is read.
+ */
+static ThreadedInst *thr_start = NULL, *thr_cur = NULL;
+static uint64_t thr_n = 0; // instructions in the blocks before `thr_start'
+
+static inline bool record_pos(int id) {
+#define POS_CASE(name) case concat(INSTR_, name):
+  switch (id) {
+    MAP(INSTR_MEM_LIST, POS_CASE)
+    MAP(INSTR_CSR_LIST, POS_CASE) return true;
+    default: return false;
+  }
+}
+
+uint64_t isa_threaded_position(vaddr_t *pc) {
+  *pc = thr_cur->s.pc;
+  return thr_n + (thr_cur - thr_start);
+}
+
+/* Pairs of instructions fused into one handler by isa_threaded_fuse(),
+ * which executes both of them and skips the entry of the second one.
+ * Since a block is only entered from its first instruction, the second
+ * one is executed alone if it is the target of some jump, which starts
+ * another block. Both destinations are always written, and `imm' of
+ * the first entry holds the result computed at fusion.
+ */
+#define FUSED_LIST(f) \
+  f(lui_addi) f(auipc_addi) f(auipc_jalr) f(slli_srli) \
+  f(slt_bxx) f(sltu_bxx) f(slti_bxx) f(sltiu_bxx)
+
+#define def_FUSED_ID(name) concat(FUSED_, name),
+enum { MAP(FUSED_LIST, def_FUSED_ID) NR_FUSED };
+#define def_FUSED_NAME(name) str(name),
+static const char *fused_name[] = { MAP(FUSED_LIST, def_FUSED_NAME) };
+static uint64_t nr_fused[NR_FUSED] = {};
+
+// `s' and `s2' are the two instructions. thr_end takes the next PC from
+// s2->dnpc when the pair ends the block, so it is set here as well.
+#define def_FHandler(name, ... /* execute body */ ) \
+  concat(thr_, name): { \
+    Decode *s = &t->s; \
+    Decode *s2 = &t[1].s; \
+    __attribute__((unused)) word_t src1 = R(s->isa.rs1); \
+    __attribute__((unused)) word_t src2 = R(s->isa.rs2); \
+    s2->dnpc = s2->snpc; \
+    __VA_ARGS__ ; \
+    R(0) = 0; \
+    nr_fused[concat(FUSED_, name)] ++; \
+    t += 2; \
+    goto *t->handler; \
+  }
+#define FHANDLER_LABEL(name) [NR_THREADED_HANDLER + concat(FUSED_, name)] = &&concat(thr_, name),
+
+// the compare of slt_bxx and the like, followed by beqz or bnez
+#define FUSED_BRANCH(cond) \
+  bool c = (cond); \
+  R(s->isa.rd) = c; \
+  s2->dnpc = (c == (s2->isa.id == INSTR_bne) ? s2->pc + s2->isa.imm : s2->snpc)
+
+void isa_threaded_fuse(ThreadedInst *t, int n) {
+  int i;
+  for (i = 0; i + 1 < n; i ++) {
+    ISADecodeInfo *a = &t[i].s.isa, *b = &t[i + 1].s.isa;
+    vaddr_t pc = t[i].s.pc;
+    int rd = a->rd;
+    int id = -1;
+    if (rd == 0) continue;
+    switch (a->id) {
+      case INSTR_lui:
+        if (b->id == INSTR_addi && b->rs1 == rd && b->rd == rd) { id = FUSED_lui_addi; a->imm += b->imm; }
+        break;
+      case INSTR_auipc:
+        if (b->id == INSTR_addi && b->rs1 == rd && b->rd == rd) { id = FUSED_auipc_addi; a->imm += pc + b->imm; }
+        else if (b->id == INSTR_jalr && b->rs1 == rd) {
+          id = FUSED_auipc_jalr;
+          a->imm += pc;
+          b->imm += a->imm; // the target
+        }
+        break;
+      case INSTR_slli:
+        // zero extension
+        if (b->id == INSTR_srli && b->rs1 == rd && b->rd == rd && (a->imm & 0x1f) == (b->imm & 0x1f)) {
+          id = FUSED_slli_srli;
+          a->imm = (word_t)-1 >> (a->imm & 0x1f);
+        }
+        break;
+      case INSTR_slt: case INSTR_sltu: case INSTR_slti: case INSTR_sltiu:
+        if ((b->id == INSTR_beq || b->id == INSTR_bne) && b->rs1 == rd && b->rs2 == 0) {
+          id = (a->id == INSTR_slt ? FUSED_slt_bxx : a->id == INSTR_sltu ? FUSED_sltu_bxx :
+              a->id == INSTR_slti ? FUSED_slti_bxx : FUSED_sltiu_bxx);
+        }
+        break;
+    }
+    if (id >= 0) {
+      t[i].handler = isa_threaded_handler[NR_THREADED_HANDLER + id];
+      i ++;
+    }
+  }
+}
+
+void isa_threaded_statistic() {
+  int i;
+  for (i = 0; i < NR_FUSED; i ++) {
+    if (nr_fused[i] != 0) Log("threaded: fused %s = %" PRIu64, fused_name[i], nr_fused[i]);
+  }
+}
+
+const void **isa_threaded_handler = NULL;
+ThreadedInst *isa_threaded_exit = NULL;
+
+uint64_t isa_exec_threaded(ThreadedInst *t, uint64_t limit) {
+  static const void *handler[NR_THREADED_HANDLER + NR_FUSED] = {
+    MAP(INSTR_LIST, THANDLER_LABEL)
+    [THREADED_END] = &&thr_end,
+    [THREADED_STALE] = &&thr_stale,
+    MAP(FUSED_LIST, FHANDLER_LABEL)
+  };
+  if (unlikely(t == NULL)) {
+    isa_threaded_handler = handler;
+    return 0;
+  }
+
+  ThreadedInst *start = t;
+  ThreadedInst *from = NULL; // THREADED_END of the previous block in the chain
+  uint64_t n = 0; // instructions in the previous blocks
+  thr_start = t;
+  thr_n = 0;
+  goto *t->handler;
+
+  MAP(INSTR_LIST, def_THandler)
+
+  def_FHandler(lui_addi,   R(s->isa.rd) = s->isa.imm)
+  def_FHandler(auipc_addi, R(s->isa.rd) = s->isa.imm)
+  def_FHandler(auipc_jalr, R(s->isa.rd) = s->isa.imm; R(s2->isa.rd) = s2->snpc; s2->dnpc = s2->isa.imm)
+  def_FHandler(slli_srli,  R(s->isa.rd) = src1 & s->isa.imm)
+  def_FHandler(slt_bxx,    FUSED_BRANCH((sword_t)src1 < (sword_t)src2))
+  def_FHandler(sltu_bxx,   FUSED_BRANCH(src1 < src2))
+  def_FHandler(slti_bxx,   FUSED_BRANCH((sword_t)src1 < (sword_t)s->isa.imm))
+  def_FHandler(sltiu_bxx,  FUSED_BRANCH(src1 < s->isa.imm))
+
+thr_end: {
+    vaddr_t pc = t[-1].s.dnpc;
+    n += t - start;
+    if (likely(nemu_state.state == NEMU_RUNNING && !g_intr_check && n + BLOCK_MAX_INSTR <= limit)) {
+      ThreadedInst *next = block_chained(t->link, pc);
+      if (next != NULL) {
+        from = t;
+        start = t = next;
+        thr_start = t;
+        thr_n = n;
+        goto *t->handler;
+      }
+    }
+    cpu.pc = pc;
+    isa_threaded_exit = t;
+    return n;
+  }
+
+thr_stale:
+  cpu.pc = t->s.pc;
+  // the chained block is dropped, so the link should be updated
+  isa_threaded_exit = (t == start ? from : NULL);
+  return n + (t - start);
+}
+#endif
+
+// Fetch and decode the instruction at s->pc without executing it.
+void isa_fetch_decode(Decode *s) {
+  fetch(s);
+  decode(s);
+}
+
+int isa_exec_once(Decode *s) {
+#ifdef CONFIG_DECODE_CACHE
+  DCacheEntry *e = dcache_entry(s->pc);
+  if (likely(e->pc == s->pc)) {
+    s->isa = e->isa;
+    g_nr_dcache_hit ++;
+    // a branch rather than ILEN(), so that the next PC does not wait for
+    // the entry to be loaded when the branch is predicted
+    s->snpc += 4;
+    IFDEF(CONFIG_RVC, if (unlikely(RVC_IS_COMPRESSED(s->isa.inst.val))) s->snpc -= 2);
+  } else {
+    fetch(s);
+    decode(s);
+    g_nr_dcache_miss ++;
+    // a 4-byte instruction may cross a page with RVC
+    vaddr_t last = (s->snpc - 1) & ~(vaddr_t)3;
+    if (vaddr_code_cacheable(s->pc) && vaddr_code_cacheable(last)) {
+      e->pc = s->pc;
+      e->isa = s->isa;
+      pmem_mark_code(s->pc);
+      pmem_mark_code(last);
+    }
+  }
+#else
+  fetch(s);
+  decode(s);
+#endif
+  s->dnpc = s->snpc;
+  s->isa.EHelper(s);
+  return 0;
 }
@@ -0,0 +1,45 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __RISCV_BITMANIP_H__
+#define __RISCV_BITMANIP_H__
+
+#include <common.h>
+
+/* Helpers of the Zbb extension. The builtins and the rotations are
+ * compiled into the bit scan and rotate instructions of the host.
+ */
+
+#ifdef CONFIG_RV_ZB
+#define ZB(...) (__VA_ARGS__)
+#else
+// without the Zba, Zbb and Zbs extensions, their instructions are illegal
+#define ZB(...) ({ INV(s->pc); (word_t)0; })
+#endif
+
+static inline word_t zb_clz(word_t x) { return (x == 0 ? 32 : __builtin_clz(x)); }
+static inline word_t zb_ctz(word_t x) { return (x == 0 ? 32 : __builtin_ctz(x)); }
+
+static inline word_t zb_rol(word_t x, word_t n) { n &= 0x1f; return (x << n) | (x >> (-n & 0x1f)); }
+static inline word_t zb_ror(word_t x, word_t n) { n &= 0x1f; return (x >> n) | (x << (-n & 0x1f)); }
+
+// set each byte to 0xff if it is not zero
+static inline word_t zb_orc_b(word_t x) {
+  // the MSB of each byte is set if any bit of the byte is set
+  word_t t = (((x & 0x7f7f7f7fu) + 0x7f7f7f7fu) | x) & 0x80808080u;
+  return (t >> 7) * 0xff;
+}
+
+#endif
@@ -0,0 +1,78 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __RISCV_CSR_H__
+#define __RISCV_CSR_H__
+
+#include <common.h>
+
+enum {
+  CSR_MSTATUS  = 0x300, CSR_MISA     = 0x301, CSR_MIE      = 0x304, CSR_MTVEC   = 0x305,
+  CSR_MSCRATCH = 0x340, CSR_MEPC     = 0x341, CSR_MCAUSE   = 0x342, CSR_MTVAL   = 0x343,
+  CSR_MIP      = 0x344, CSR_SATP     = 0x180,
+  CSR_MCYCLE   = 0xb00, CSR_MINSTRET = 0xb02, CSR_MCYCLEH  = 0xb80, CSR_MINSTRETH = 0xb82,
+  CSR_CYCLE    = 0xc00, CSR_TIME     = 0xc01, CSR_INSTRET  = 0xc02,
+  CSR_CYCLEH   = 0xc80, CSR_TIMEH    = 0xc81, CSR_INSTRETH = 0xc82,
+  CSR_MVENDORID = 0xf11, CSR_MARCHID = 0xf12, CSR_MIMPID   = 0xf13, CSR_MHARTID = 0xf14,
+  CSR_VSTART   = 0x008, CSR_VL       = 0xc20, CSR_VTYPE    = 0xc21, CSR_VLENB   = 0xc22,
+};
+
+/* Only M-mode is modeled, so mstatus.MPP always reads as M, and Sv32
+ * translates in M-mode whenever satp.MODE selects it.
+ */
+#define MSTATUS_MIE  (1u << 3)
+#define MSTATUS_MPIE (1u << 7)
+#define MSTATUS_MPP  (3u << 11)
+#define MSTATUS_MPRV (1u << 17)
+
+// bits of mie and mip
+#define MIP_MSIP (1u << 3)
+#define MIP_MTIP (1u << 7)
+#define MIP_MEIP (1u << 11)
+
+// mcause
+#define INTR_BIT (1u << 31)
+enum {
+  IRQ_MSI = 3, IRQ_MTI = 7, IRQ_MEI = 11,
+};
+enum {
+  EXC_LAM = 4, EXC_SAM = 6, // address misaligned of load and store/AMO
+  EXC_ECALL_M = 11,
+  EXC_IPF = 12, EXC_LPF = 13, EXC_SPF = 15, // page faults of ifetch, load and store/AMO
+};
+
+// CSRs with the address[11:10] = 3 are read-only
+#define CSR_READ_ONLY(addr) (((addr) >> 10) == 3)
+
+// operations of csrrw/csrrs/csrrc and their immediate forms
+enum { CSR_OP_W, CSR_OP_S, CSR_OP_C };
+
+struct Decode;
+/* Access the CSR in the immediate of `s' with `op' and `val', and return
+ * its old value. An unsupported CSR makes the instruction invalid.
+ */
+word_t csr_access(struct Decode *s, int op, word_t val);
+
+// system/intr.c
+// abort the current instruction with the exception `NO' and mtval = `val'
+void intr_raise_exc(word_t NO, word_t val) __attribute__((noreturn));
+vaddr_t intr_mret();
+word_t intr_mip();
+
+// system/mmu.c
+void mmu_write_satp(word_t val);
+void mmu_sfence_vma(bool has_vaddr, vaddr_t vaddr, bool has_asid, word_t asid);
+
+#endif
@@ -0,0 +1,52 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __RISCV_OPERAND_H__
+#define __RISCV_OPERAND_H__
+
+#include <stdint.h>
+#include <macro.h>
+
+/* Operands of each instruction type. The type of an instruction is
+ * known at compile time where it is matched, so operand_<type>() is
+ * inlined there, and only extracts the fields of the type. Register
+ * indices of unused source operands are kept as 0, so that the execution
+ * helpers can read both sources unconditionally.
+ */
+typedef struct {
+  uint32_t imm;
+  uint8_t rd, rs1, rs2;
+} Operand;
+
+#define rdF(i)  BITS(i, 11, 7)
+#define rs1F(i) BITS(i, 19, 15)
+#define rs2F(i) BITS(i, 24, 20)
+#define immI(i) SEXT(BITS(i, 31, 20), 12)
+#define immS(i) ((SEXT(BITS(i, 31, 25), 7) << 5) | BITS(i, 11, 7))
+#define immB(i) (SEXT(BITS(i, 31, 31), 1) << 12 | BITS(i, 7, 7) << 11 \
+                 | BITS(i, 30, 25) << 5 | BITS(i, 11, 8) << 1)
+#define immU(i) (SEXT(BITS(i, 31, 12), 20) << 12)
+#define immJ(i) (SEXT(BITS(i, 31, 31), 1) << 20 | BITS(i, 19, 12) << 12 \
+                 | BITS(i, 20, 20) << 11 | BITS(i, 30, 21) << 1)
+
+static inline Operand operand_R(uint32_t i) { return (Operand) { 0,       rdF(i), rs1F(i), rs2F(i) }; }
+static inline Operand operand_I(uint32_t i) { return (Operand) { immI(i), rdF(i), rs1F(i), 0       }; }
+static inline Operand operand_S(uint32_t i) { return (Operand) { immS(i), rdF(i), rs1F(i), rs2F(i) }; }
+static inline Operand operand_B(uint32_t i) { return (Operand) { immB(i), rdF(i), rs1F(i), rs2F(i) }; }
+static inline Operand operand_U(uint32_t i) { return (Operand) { immU(i), rdF(i), 0,       0       }; }
+static inline Operand operand_J(uint32_t i) { return (Operand) { immJ(i), rdF(i), 0,       0       }; }
+static inline Operand operand_N(uint32_t i) { return (Operand) { 0,       rdF(i), 0,       0       }; }
+
+#endif
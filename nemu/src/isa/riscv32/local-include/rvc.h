@@ -0,0 +1,32 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __RISCV_RVC_H__
+#define __RISCV_RVC_H__
+
+#include <common.h>
+
+// instructions with the lowest 2 bits other than 0b11 are compressed
+#define RVC_IS_COMPRESSED(inst) (((inst) & 0x3) != 0x3)
+
+// an all-zero instruction, which is decoded as an invalid one
+#define RVC_ILLEGAL 0
+
+/* Expand the compressed instruction `c' into its 32-bit equivalent,
+ * or RVC_ILLEGAL if `c' is not a valid RV32C instruction.
+ */
+uint32_t rvc_expand(uint32_t c);
+
+#endif
@@ -0,0 +1,69 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __RISCV_VECTOR_H__
+#define __RISCV_VECTOR_H__
+
+#include <common.h>
+
+// operations of the element-wise arithmetic instructions,
+// where VOP_MERGE is vmerge, or vmv.v.{v,x,i} with vm = 1
+enum {
+  VOP_ADD, VOP_SUB, VOP_RSUB, VOP_AND, VOP_OR, VOP_XOR,
+  VOP_SLL, VOP_SRL, VOP_SRA, VOP_MINU, VOP_MIN, VOP_MAXU, VOP_MAX,
+  VOP_MUL, VOP_MULH, VOP_MULHU, VOP_MACC, VOP_MERGE,
+  // comparisons writing a mask
+  VOP_MSEQ, VOP_MSNE, VOP_MSLTU, VOP_MSLT, VOP_MSLEU, VOP_MSLE, VOP_MSGTU, VOP_MSGT,
+  NR_VOP
+};
+
+// operations of the reductions, in the order of their funct6
+enum { VRED_SUM, VRED_AND, VRED_OR, VRED_XOR, VRED_MINU, VRED_MIN, VRED_MAXU, VRED_MAX };
+
+// addressing modes of loads and stores
+enum { VMEM_UNIT, VMEM_STRIDE, VMEM_INDEX };
+
+// the second source operand of the arithmetic instructions,
+// in the execution bodies of isa-all-instr.h
+#define VV  false, 0
+#define VX  true, src1
+#define VI  true, SEXT(s->isa.rs1, 5)
+#define VIU true, s->isa.rs1
+
+struct Decode;
+
+#ifdef CONFIG_RV_V
+word_t vec_set(struct Decode *s, word_t avl, word_t vtype, bool uimm);
+void vec_load(struct Decode *s, int eew, int mode, word_t stride);
+void vec_store(struct Decode *s, int eew, int mode, word_t stride);
+void vec_arith(struct Decode *s, int op, bool scalar, word_t x);
+void vec_red(struct Decode *s, int op);
+word_t vec_mv_x_s(struct Decode *s);
+void vec_mv_s_x(struct Decode *s, word_t x);
+void vec_id(struct Decode *s);
+#else
+// without the V extension, vector instructions are illegal
+#define vec_inv(s, ...)  ({ INV((s)->pc); (word_t)0; })
+#define vec_set    vec_inv
+#define vec_load   vec_inv
+#define vec_store  vec_inv
+#define vec_arith  vec_inv
+#define vec_red    vec_inv
+#define vec_mv_x_s vec_inv
+#define vec_mv_s_x vec_inv
+#define vec_id     vec_inv
+#endif
+
+#endif
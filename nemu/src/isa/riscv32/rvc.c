@@ -0,0 +1,151 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <common.h>
+#include "local-include/rvc.h"
+
+#ifdef CONFIG_RVC
+/* The C extension. A compressed instruction is expanded into its 32-bit
+ * equivalent before decoding, so that it runs with the same execution
+ * helper. The result is kept by the decode cache and the block engines
+ * with the PC of the instruction, so each instruction is expanded once.
+ */
+
+enum {
+  OP_LOAD = 0x03, OP_IMM = 0x13, OP_STORE = 0x23, OP_REG = 0x33,
+  OP_LUI = 0x37, OP_BRANCH = 0x63, OP_JALR = 0x67, OP_JAL = 0x6f,
+};
+
+#define INST_EBREAK 0x00100073
+
+static inline uint32_t enc_r(int funct7, int rs2, int rs1, int funct3, int rd, int op) {
+  return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | op;
+}
+
+static inline uint32_t enc_i(uint32_t imm, int rs1, int funct3, int rd, int op) {
+  return BITS(imm, 11, 0) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | op;
+}
+
+static inline uint32_t enc_s(uint32_t imm, int rs2, int rs1, int funct3) {
+  return BITS(imm, 11, 5) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 |
+    BITS(imm, 4, 0) << 7 | OP_STORE;
+}
+
+static inline uint32_t enc_b(uint32_t imm, int rs2, int rs1, int funct3) {
+  return BITS(imm, 12, 12) << 31 | BITS(imm, 10, 5) << 25 | rs2 << 20 | rs1 << 15 |
+    funct3 << 12 | BITS(imm, 4, 1) << 8 | BITS(imm, 11, 11) << 7 | OP_BRANCH;
+}
+
+static inline uint32_t enc_j(uint32_t imm, int rd) {
+  return BITS(imm, 20, 20) << 31 | BITS(imm, 10, 1) << 21 | BITS(imm, 11, 11) << 20 |
+    BITS(imm, 19, 12) << 12 | rd << 7 | OP_JAL;
+}
+
+// x8 - x15 in the 3-bit register fields
+#define RC(c, lo) (8 + BITS(c, (lo) + 2, lo))
+
+// immediates, see "RVC Instruction Set Listings" in the RISC-V spec
+#define imm6(c)    SEXT(BITS(c, 12, 12) << 5 | BITS(c, 6, 2), 6)
+#define immJ(c)    SEXT(BITS(c, 12, 12) << 11 | BITS(c, 11, 11) << 4 | BITS(c, 10, 9) << 8 | \
+    BITS(c, 8, 8) << 10 | BITS(c, 7, 7) << 6 | BITS(c, 6, 6) << 7 | BITS(c, 5, 3) << 1 | \
+    BITS(c, 2, 2) << 5, 12)
+#define immB(c)    SEXT(BITS(c, 12, 12) << 8 | BITS(c, 11, 10) << 3 | BITS(c, 6, 5) << 6 | \
+    BITS(c, 4, 3) << 1 | BITS(c, 2, 2) << 5, 9)
+#define uimmW(c)   (BITS(c, 12, 10) << 3 | BITS(c, 6, 6) << 2 | BITS(c, 5, 5) << 6)
+#define uimmLWSP(c) (BITS(c, 12, 12) << 5 | BITS(c, 6, 4) << 2 | BITS(c, 3, 2) << 6)
+#define uimmSWSP(c) (BITS(c, 12, 9) << 2 | BITS(c, 8, 7) << 6)
+#define uimm4SPN(c) (BITS(c, 12, 11) << 4 | BITS(c, 10, 7) << 6 | BITS(c, 6, 6) << 2 | \
+    BITS(c, 5, 5) << 3)
+#define imm16SP(c) SEXT(BITS(c, 12, 12) << 9 | BITS(c, 6, 6) << 4 | BITS(c, 5, 5) << 6 | \
+    BITS(c, 4, 3) << 7 | BITS(c, 2, 2) << 5, 10)
+
+static uint32_t expand_q0(uint32_t c) {
+  switch (BITS(c, 15, 13)) {
+    case 0: // c.addi4spn
+      if (uimm4SPN(c) == 0) return RVC_ILLEGAL;
+      return enc_i(uimm4SPN(c), 2, 0, RC(c, 2), OP_IMM);
+    case 2: return enc_i(uimmW(c), RC(c, 7), 2, RC(c, 2), OP_LOAD);  // c.lw
+    case 6: return enc_s(uimmW(c), RC(c, 2), RC(c, 7), 2);           // c.sw
+    default: return RVC_ILLEGAL; // floating-point loads and stores
+  }
+}
+
+static uint32_t expand_q1(uint32_t c) {
+  int rd = BITS(c, 11, 7);
+  int rdc = RC(c, 7), rs2c = RC(c, 2);
+  switch (BITS(c, 15, 13)) {
+    case 0: return enc_i(imm6(c), rd, 0, rd, OP_IMM);  // c.addi, c.nop
+    case 1: return enc_j(immJ(c), 1);                  // c.jal
+    case 2: return enc_i(imm6(c), 0, 0, rd, OP_IMM);   // c.li
+    case 3:
+      if (rd == 2) { // c.addi16sp
+        if (imm16SP(c) == 0) return RVC_ILLEGAL;
+        return enc_i(imm16SP(c), 2, 0, 2, OP_IMM);
+      }
+      // c.lui
+      if (imm6(c) == 0) return RVC_ILLEGAL;
+      return (imm6(c) << 12) | rd << 7 | OP_LUI;
+    case 4:
+      switch (BITS(c, 11, 10)) {
+        case 0: case 1: // c.srli, c.srai, shamt[5] must be 0 for RV32
+          if (BITS(c, 12, 12)) return RVC_ILLEGAL;
+          return enc_r(BITS(c, 10, 10) << 5, BITS(c, 6, 2), rdc, 5, rdc, OP_IMM);
+        case 2: return enc_i(imm6(c), rdc, 7, rdc, OP_IMM); // c.andi
+        default:
+          if (BITS(c, 12, 12)) return RVC_ILLEGAL; // c.subw and c.addw of RV64
+          switch (BITS(c, 6, 5)) {
+            case 0:  return enc_r(0x20, rs2c, rdc, 0, rdc, OP_REG); // c.sub
+            case 1:  return enc_r(0,    rs2c, rdc, 4, rdc, OP_REG); // c.xor
+            case 2:  return enc_r(0,    rs2c, rdc, 6, rdc, OP_REG); // c.or
+            default: return enc_r(0,    rs2c, rdc, 7, rdc, OP_REG); // c.and
+          }
+      }
+    case 5: return enc_j(immJ(c), 0);                   // c.j
+    case 6: return enc_b(immB(c), 0, RC(c, 7), 0);      // c.beqz
+    default: return enc_b(immB(c), 0, RC(c, 7), 1);     // c.bnez
+  }
+}
+
+static uint32_t expand_q2(uint32_t c) {
+  int rd = BITS(c, 11, 7), rs2 = BITS(c, 6, 2);
+  switch (BITS(c, 15, 13)) {
+    case 0: // c.slli, shamt[5] must be 0 for RV32
+      if (BITS(c, 12, 12)) return RVC_ILLEGAL;
+      return enc_r(0, rs2, rd, 1, rd, OP_IMM);
+    case 2: // c.lwsp
+      if (rd == 0) return RVC_ILLEGAL;
+      return enc_i(uimmLWSP(c), 2, 2, rd, OP_LOAD);
+    case 4:
+      if (BITS(c, 12, 12) == 0) {
+        if (rs2 != 0) return enc_r(0, rs2, 0, 0, rd, OP_REG); // c.mv
+        if (rd == 0) return RVC_ILLEGAL;
+        return enc_i(0, rd, 0, 0, OP_JALR);                  // c.jr
+      }
+      if (rs2 != 0) return enc_r(0, rs2, rd, 0, rd, OP_REG); // c.add
+      if (rd == 0) return INST_EBREAK;                       // c.ebreak
+      return enc_i(0, rd, 0, 1, OP_JALR);                    // c.jalr
+    case 6: return enc_s(uimmSWSP(c), rs2, 2, 2);            // c.swsp
+    default: return RVC_ILLEGAL; // floating-point loads and stores
+  }
+}
+
+uint32_t rvc_expand(uint32_t c) {
+  switch (c & 0x3) {
+    case 0:  return expand_q0(c);
+    case 1:  return expand_q1(c);
+    default: return expand_q2(c);
+  }
+}
+#endif
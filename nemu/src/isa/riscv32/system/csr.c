@@ -0,0 +1,120 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/decode.h>
+#include <cpu/block.h>
+#include "../local-include/csr.h"
+
+#define MISA_EXT(c) (1u << ((c) - 'a'))
+#define MISA ((1u << 30) | MISA_EXT('i') | MISA_EXT('m') | MISA_EXT('a') | \
+    MUXDEF(CONFIG_RVC, MISA_EXT('c'), 0) | MUXDEF(CONFIG_RV_V, MISA_EXT('v'), 0))
+
+#define MSTATUS_WMASK (MSTATUS_MIE | MSTATUS_MPIE | MSTATUS_MPRV)
+#define MIE_WMASK (MIP_MSIP | MIP_MTIP | MIP_MEIP)
+
+/* mcycle and minstret count the guest instructions executed by the hart,
+ * from which they are kept as offsets when they are written. Inside a
+ * block, those executed in the current run are not in g_nr_guest_inst.
+ */
+extern HART_LOCAL uint64_t g_nr_guest_inst;
+static HART_LOCAL uint64_t mcycle_off = 0, minstret_off = 0;
+
+static inline uint64_t nr_inst() {
+  return g_nr_guest_inst + MUXDEF(CONFIG_ENGINE_BLOCK, block_nr_inst(), 0);
+}
+
+static bool csr_read(uint32_t addr, word_t *val) {
+  switch (addr) {
+    case CSR_MSTATUS: *val = cpu.mstatus; return true;
+    case CSR_MISA: *val = MISA; return true;
+    case CSR_MIE: *val = cpu.mie; return true;
+    case CSR_MTVEC: *val = cpu.mtvec; return true;
+    case CSR_MSCRATCH: *val = cpu.mscratch; return true;
+    case CSR_MEPC: *val = cpu.mepc; return true;
+    case CSR_MCAUSE: *val = cpu.mcause; return true;
+    case CSR_MTVAL: *val = cpu.mtval; return true;
+    case CSR_MIP: *val = intr_mip(); return true;
+    case CSR_SATP: *val = cpu.satp; return true;
+    case CSR_MCYCLE:   case CSR_CYCLE:    *val = nr_inst() + mcycle_off; return true;
+    case CSR_MCYCLEH:  case CSR_CYCLEH:   *val = (nr_inst() + mcycle_off) >> 32; return true;
+    case CSR_MINSTRET: case CSR_INSTRET:  *val = nr_inst() + minstret_off; return true;
+    case CSR_MINSTRETH: case CSR_INSTRETH: *val = (nr_inst() + minstret_off) >> 32; return true;
+    case CSR_TIME:  *val = get_guest_time(); return true;
+    case CSR_TIMEH: *val = get_guest_time() >> 32; return true;
+    case CSR_MVENDORID: case CSR_MARCHID: case CSR_MIMPID: *val = 0; return true;
+    case CSR_MHARTID: *val = hart_id(); return true;
+#ifdef CONFIG_RV_V
+    case CSR_VSTART: *val = cpu.vstart; return true;
+    case CSR_VL:     *val = cpu.vl; return true;
+    case CSR_VTYPE:  *val = cpu.vtype; return true;
+    case CSR_VLENB:  *val = CONFIG_RV_VLEN / 8; return true;
+#endif
+    default: return false;
+  }
+}
+
+// replace the low or high half of the 64-bit counter `off' + nr_inst()
+static uint64_t counter_write(uint64_t off, word_t val, bool high) {
+  uint64_t now = nr_inst() + off;
+  now = (high ? (now & 0xffffffffu) | ((uint64_t)val << 32) : (now & ~0xffffffffull) | val);
+  return now - nr_inst();
+}
+
+static void csr_write(uint32_t addr, word_t val) {
+  switch (addr) {
+    case CSR_MSTATUS:
+      cpu.mstatus = (val & MSTATUS_WMASK) | MSTATUS_MPP;
+      g_intr_check = true;
+      break;
+    case CSR_MIE:
+      cpu.mie = val & MIE_WMASK;
+      g_intr_check = true;
+      break;
+    // direct and vectored modes
+    case CSR_MTVEC: cpu.mtvec = val & ~(word_t)2; break;
+    case CSR_MSCRATCH: cpu.mscratch = val; break;
+    case CSR_MEPC: cpu.mepc = val & ~(word_t)MUXDEF(CONFIG_RVC, 1, 3); break;
+    case CSR_MCAUSE: cpu.mcause = val; break;
+    case CSR_MTVAL: cpu.mtval = val; break;
+    // the pending bits are set by devices, and cleared when taken
+    case CSR_MIP: break;
+    case CSR_SATP: mmu_write_satp(val); break;
+    case CSR_MCYCLE:    mcycle_off = counter_write(mcycle_off, val, false); break;
+    case CSR_MCYCLEH:   mcycle_off = counter_write(mcycle_off, val, true); break;
+    case CSR_MINSTRET:  minstret_off = counter_write(minstret_off, val, false); break;
+    case CSR_MINSTRETH: minstret_off = counter_write(minstret_off, val, true); break;
+    IFDEF(CONFIG_RV_V, case CSR_VSTART: cpu.vstart = val; break);
+  }
+}
+
+word_t csr_access(Decode *s, int op, word_t val) {
+  uint32_t addr = BITS(s->isa.inst.val, 31, 20);
+  word_t old;
+  if (!csr_read(addr, &old)) {
+    INV(s->pc);
+    return 0;
+  }
+  // csrrs/csrrc with rs1 (or uimm) = 0 do not write the CSR
+  if (op == CSR_OP_W || s->isa.rs1 != 0) {
+    if (CSR_READ_ONLY(addr)) {
+      INV(s->pc);
+      return 0;
+    }
+    csr_write(addr, op == CSR_OP_W ? val : op == CSR_OP_S ? old | val : old & ~val);
+  }
+  return old;
+}
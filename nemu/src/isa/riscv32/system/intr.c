@@ -14,15 +14,67 @@
 ***************************************************************************************/
 
 #include <isa.h>
+#include <cpu/cpu.h>
+#include "../local-include/csr.h"
+
+/* Traps go to M-mode, the only privilege mode. Devices raise interrupts
+ * asynchronously, e.g. in the handler of the alarm signal, so they only
+ * set bits in `dev_mip', which are moved into mip when the hart looks at
+ * it. NEMU has no timer compare register or interrupt controller, so
+ * MTIP and MEIP are cleared when the interrupt is taken.
+ */
+
+static HART_LOCAL uint32_t dev_mip = 0;
+static HART_LOCAL word_t tval = 0; // mtval of the next trap
 
 word_t isa_raise_intr(word_t NO, vaddr_t epc) {
-  /* TODO: Trigger an interrupt/exception with ``NO''.
-   * Then return the address of the interrupt/exception vector.
-   */
+  cpu.mepc = epc;
+  cpu.mcause = NO;
+  cpu.mtval = tval;
+  tval = 0;
+  // MPIE = MIE, MIE = 0
+  word_t mpie = (cpu.mstatus & MSTATUS_MIE) ? MSTATUS_MPIE : 0;
+  cpu.mstatus = (cpu.mstatus & ~(MSTATUS_MIE | MSTATUS_MPIE)) | mpie;
+  vaddr_t base = cpu.mtvec & ~(word_t)3;
+  // vectored mode
+  if ((cpu.mtvec & 1) && (NO & INTR_BIT)) return base + 4 * (NO & ~INTR_BIT);
+  return base;
+}
 
-  return 0;
+void intr_raise_exc(word_t NO, word_t val) {
+  tval = val;
+  longjmp_exception(NO);
+}
+
+vaddr_t intr_mret() {
+  // MIE = MPIE, MPIE = 1
+  word_t mie = (cpu.mstatus & MSTATUS_MPIE) ? MSTATUS_MIE : 0;
+  cpu.mstatus = (cpu.mstatus & ~MSTATUS_MIE) | mie | MSTATUS_MPIE;
+  g_intr_check = true;
+  return cpu.mepc;
+}
+
+word_t intr_mip() {
+  if (dev_mip != 0) cpu.mip |= __atomic_exchange_n(&dev_mip, 0, __ATOMIC_RELAXED);
+  return cpu.mip;
 }
 
 word_t isa_query_intr() {
-  return INTR_EMPTY;
+  word_t pending = intr_mip() & cpu.mie;
+  if (!(cpu.mstatus & MSTATUS_MIE) || pending == 0) return INTR_EMPTY;
+  int irq = (pending & MIP_MEIP) ? IRQ_MEI : IRQ_MTI;
+  cpu.mip &= ~(1u << irq);
+  return INTR_BIT | irq;
+}
+
+void isa_dev_raise_intr(int irq) {
+  __atomic_fetch_or(&dev_mip, (irq == DEV_IRQ_TIMER ? MIP_MTIP : MIP_MEIP), __ATOMIC_RELAXED);
+}
+
+word_t isa_mmu_fault(vaddr_t vaddr, int type) {
+  static const word_t cause[] = {
+    [MEM_TYPE_IFETCH] = EXC_IPF, [MEM_TYPE_READ] = EXC_LPF, [MEM_TYPE_WRITE] = EXC_SPF,
+  };
+  tval = vaddr;
+  return cause[type];
 }
@@ -16,7 +16,141 @@
 #include <isa.h>
 #include <memory/vaddr.h>
 #include <memory/paddr.h>
+#include <cpu/block.h>
+#include "../local-include/csr.h"
+
+#ifdef CONFIG_RV_SV32
+/* Sv32 page table walker with a direct-mapped TLB indexed by VPN. Each
+ * entry caches the leaf PTE of a 4KB page and is tagged with the ASID
+ * of satp, unless the PTE is global. A megapage is cached as the 4KB
+ * pages which have been accessed. The software TLB of vaddr.c and the
+ * caches of guest code hold translations too, so they are flushed with
+ * this TLB. Privilege modes are not modeled, so U is not checked.
+ */
+
+#define SATP_MODE(satp) ((satp) >> 31)
+#define SATP_ASID(satp) BITS(satp, 30, 22)
+#define SATP_PPN(satp)  BITS(satp, 21, 0)
+
+enum { PTE_V = 0x1, PTE_R = 0x2, PTE_W = 0x4, PTE_X = 0x8,
+  PTE_U = 0x10, PTE_G = 0x20, PTE_A = 0x40, PTE_D = 0x80 };
+#define PTE_PPN(pte) ((pte) >> 10)
+
+#define TLB_SIZE CONFIG_RV_TLB_SIZE
+static_assert((TLB_SIZE & (TLB_SIZE - 1)) == 0, "TLB size should be a power of 2");
+
+typedef struct {
+  bool valid;
+  bool mega;       // from a megapage
+  uint16_t asid;
+  uint32_t vpn;
+  uint32_t pte;    // PPN of the 4KB page and flags
+  paddr_t pte_addr;
+} TLBEntry;
+
+static HART_LOCAL TLBEntry tlb[TLB_SIZE] = {};
+static HART_LOCAL uint64_t nr_tlb_hit = 0, nr_walk = 0;
+
+static inline TLBEntry* tlb_entry(uint32_t vpn) { return &tlb[vpn & (TLB_SIZE - 1)]; }
+
+static inline bool tlb_match(TLBEntry *e, uint32_t vpn, uint16_t asid) {
+  return e->valid && e->vpn == vpn && (e->asid == asid || (e->pte & PTE_G));
+}
+
+// drop what is derived from the TLB in the host
+static void flush_host() {
+  IFDEF(CONFIG_SOFT_TLB, soft_tlb_flush());
+  IFDEF(CONFIG_DECODE_CACHE, isa_dcache_flush());
+  IFDEF(CONFIG_ENGINE_BLOCK, block_flush());
+}
+
+static const uint32_t perm[] = {
+  [MEM_TYPE_IFETCH] = PTE_X, [MEM_TYPE_READ] = PTE_R, [MEM_TYPE_WRITE] = PTE_W,
+};
+
+// Walk the page table, and fill `e' if the access is allowed.
+static bool walk(TLBEntry *e, vaddr_t vaddr, int type) {
+  uint64_t a = (uint64_t)SATP_PPN(cpu.satp) << 12;
+  uint32_t vpn = vaddr >> 12;
+  int level;
+  for (level = 1; level >= 0; level --) {
+    if (a >> 32) return false;
+    paddr_t pte_addr = a + BITS(vpn, 10 * level + 9, 10 * level) * 4;
+    if (!in_pmem(pte_addr)) return false;
+    uint32_t pte = paddr_read(pte_addr, 4);
+    if (!(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W))) return false;
+    if (pte & (PTE_R | PTE_X)) {
+      if (level == 1 && BITS(pte, 19, 10) != 0) return false; // misaligned megapage
+      if (!(pte & perm[type])) return false;
+      // set A and D in the page table
+      uint32_t ad = PTE_A | (type == MEM_TYPE_WRITE ? PTE_D : 0);
+      if ((pte & ad) != ad) {
+        pte |= ad;
+        paddr_write(pte_addr, 4, pte);
+      }
+      if (level == 1) pte |= BITS(vpn, 9, 0) << 10;
+      *e = (TLBEntry){ .valid = true, .mega = (level == 1), .asid = SATP_ASID(cpu.satp),
+        .vpn = vpn, .pte = pte, .pte_addr = pte_addr };
+      return true;
+    }
+    a = (uint64_t)PTE_PPN(pte) << 12;
+  }
+  return false;
+}
 
+paddr_t isa_mmu_translate(vaddr_t vaddr, int len, int type) {
+  uint32_t vpn = vaddr >> 12;
+  TLBEntry *e = tlb_entry(vpn);
+  if (likely(tlb_match(e, vpn, SATP_ASID(cpu.satp)) && (e->pte & perm[type]) &&
+        (type != MEM_TYPE_WRITE || (e->pte & PTE_D)))) {
+    nr_tlb_hit ++;
+  } else {
+    nr_walk ++;
+    if (!walk(e, vaddr, type)) return MEM_RET_FAIL;
+  }
+  uint64_t pa = (uint64_t)PTE_PPN(e->pte) << 12;
+  if (pa >> 32) return MEM_RET_FAIL;
+  return (paddr_t)pa | MEM_RET_OK;
+}
+
+void mmu_write_satp(word_t val) {
+  if (val == cpu.satp) return;
+  cpu.satp = val;
+  flush_host();
+}
+
+void mmu_sfence_vma(bool has_vaddr, vaddr_t vaddr, bool has_asid, word_t asid) {
+  int i;
+  for (i = 0; i < TLB_SIZE; i ++) {
+    TLBEntry *e = &tlb[i];
+    if (!e->valid) continue;
+    if (has_vaddr && e->vpn != (vaddr >> 12) &&
+        !(e->mega && (e->vpn >> 10) == (vaddr >> 22))) continue;
+    // global mappings are kept when an ASID is given
+    if (has_asid && (e->asid != BITS(asid, 8, 0) || (e->pte & PTE_G))) continue;
+    e->valid = false;
+  }
+  flush_host();
+}
+
+void isa_mmu_statistic() {
+  if (nr_tlb_hit + nr_walk == 0) return;
+  Log("mmu: TLB hits = %" PRIu64 ", page table walks = %" PRIu64, nr_tlb_hit, nr_walk);
+}
+#else
 paddr_t isa_mmu_translate(vaddr_t vaddr, int len, int type) {
   return MEM_RET_FAIL;
 }
+
+// Sv32 is not supported, so that a write of satp does not take effect
+// if it selects Sv32
+void mmu_write_satp(word_t val) {
+  if ((val >> (sizeof(word_t) * 8 - 1)) == 0) cpu.satp = val;
+}
+
+void mmu_sfence_vma(bool has_vaddr, vaddr_t vaddr, bool has_asid, word_t asid) {
+}
+
+void isa_mmu_statistic() {
+}
+#endif
@@ -0,0 +1,351 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+
+#ifdef CONFIG_RV_V
+#include <cpu/cpu.h>
+#include <cpu/decode.h>
+#include <memory/vaddr.h>
+#include "local-include/reg.h"
+#include "local-include/vector.h"
+
+/* The integer subset of the V extension with SEW of 8, 16 and 32 bits.
+ * The registers of a group are contiguous in cpu.vr, so that the
+ * element loop of an arithmetic instruction runs over the bytes of the
+ * group with host vectors of VBYTES bytes. Inactive elements (by the
+ * mask) and tail elements are left undisturbed.
+ */
+
+#define VLEN  CONFIG_RV_VLEN
+#define VLENB (VLEN / 8)
+static_assert(VLEN >= 128 && (VLEN & (VLEN - 1)) == 0, "VLEN should be a power of 2 and at least 128");
+
+#define VTYPE_VILL (1u << 31)
+
+static inline int vsew() { return BITS(cpu.vtype, 5, 3); } // log2(SEW / 8)
+static inline int vlmul() { return SEXT(BITS(cpu.vtype, 2, 0), 3); } // log2(LMUL)
+static inline bool vmask_bit(int i) { return (cpu.vr[i >> 3] >> (i & 7)) & 1; } // in v0
+static inline uint8_t* vreg(int r) { return &cpu.vr[r * VLENB]; }
+
+static word_t velem(int r, int i, int sew) {
+  uint8_t *p = vreg(r) + (i << sew);
+  switch (sew) {
+    case 0: return *(uint8_t *)p;
+    case 1: return *(uint16_t *)p;
+    default: return *(uint32_t *)p;
+  }
+}
+
+static void velem_set(int r, int i, int sew, word_t val) {
+  uint8_t *p = vreg(r) + (i << sew);
+  switch (sew) {
+    case 0: *(uint8_t *)p = val; break;
+    case 1: *(uint16_t *)p = val; break;
+    default: *(uint32_t *)p = val; break;
+  }
+}
+
+static inline sword_t vsext(word_t val, int sew) {
+  int shift = 32 - (8 << sew);
+  return (sword_t)(val << shift) >> shift;
+}
+
+// Check that a group of 2^`emul' registers (at least one) starting at
+// `r' is aligned. The instruction is illegal if not.
+static bool vgroup_ok(Decode *s, int r, int emul) {
+  bool ok = (emul >= -3 && emul <= 3 && (emul <= 0 || (r & ((1 << emul) - 1)) == 0));
+  if (!ok) INV(s->pc);
+  return ok;
+}
+
+// vector instructions other than vset{i}vl{i} are illegal with vtype.vill
+static bool vtype_ok(Decode *s) {
+  bool ok = !(cpu.vtype & VTYPE_VILL);
+  if (!ok) INV(s->pc);
+  return ok;
+}
+
+word_t vec_set(Decode *s, word_t avl, word_t vtype, bool uimm) {
+  int sew = BITS(vtype, 5, 3), lmul = SEXT(BITS(vtype, 2, 0), 3);
+  // ELEN = 32, so a fractional LMUL should hold at least one element of SEW
+  bool ill = (vtype >> 8) != 0 || sew > 2 || lmul == -4 || (lmul < 0 && (8 << sew) > (32 >> -lmul));
+  if (ill) {
+    cpu.vtype = VTYPE_VILL;
+    cpu.vl = 0;
+    return 0;
+  }
+  word_t vlmax = (lmul >= 0 ? (VLEN << lmul) : (VLEN >> -lmul)) >> (3 + sew);
+  if (!uimm && s->isa.rs1 == 0) avl = (s->isa.rd == 0 ? cpu.vl : vlmax);
+  cpu.vtype = vtype;
+  cpu.vl = (avl < vlmax ? avl : vlmax);
+  cpu.vstart = 0;
+  return cpu.vl;
+}
+
+// --- loads and stores ---
+
+// Copy the elements [i, vl) of `eew' bytes between the register group
+// `r' and the guest memory at `addr' one by one. An exception in the
+// middle leaves vstart at the element.
+static void vmem_elems(Decode *s, int r, int i, int eew_log, int mode, vaddr_t addr,
+    word_t stride, int index_sew, bool store) {
+  int vs2 = s->isa.rs2;
+  bool vm = BITS(s->isa.inst.val, 25, 25);
+  int sew = (mode == VMEM_INDEX ? vsew() : eew_log);
+  for (; i < cpu.vl; i ++) {
+    if (!vm && !vmask_bit(i)) continue;
+    cpu.vstart = i;
+    vaddr_t a = (mode == VMEM_UNIT ? addr + (i << eew_log) :
+                 mode == VMEM_STRIDE ? addr + i * stride : addr + velem(vs2, i, index_sew));
+    if (store) vaddr_write(a, 1 << sew, velem(r, i, sew));
+    else velem_set(r, i, sew, vaddr_read(a, 1 << sew));
+  }
+}
+
+// Copy the bytes of the elements [vstart, vl) of an unmasked unit-stride
+// access page by page with memcpy(), if they are in pmem.
+static void vmem_unit(Decode *s, int r, int eew_log, vaddr_t addr, bool store) {
+  int i = cpu.vstart;
+  while (i < cpu.vl) {
+    vaddr_t a = addr + (i << eew_log);
+    int len = (cpu.vl - i) << eew_log;
+    int room = PAGE_SIZE - (a & PAGE_MASK);
+    if (len > room) len = room;
+    cpu.vstart = i;
+    void *h = (store ? vaddr_host_rmw(a, len) : vaddr_host_read(a, len));
+    if (h == NULL) { vmem_elems(s, r, i, eew_log, VMEM_UNIT, addr, 0, 0, store); return; }
+    if (store) memcpy(h, vreg(r) + (i << eew_log), len);
+    else memcpy(vreg(r) + (i << eew_log), h, len);
+    i += len >> eew_log;
+  }
+}
+
+static void vmem(Decode *s, int eew, int mode, word_t stride, bool store) {
+  if (!vtype_ok(s)) return;
+  int r = s->isa.rd;
+  int eew_log = __builtin_ctz(eew);
+  // the data of indexed accesses are in SEW, and the indices in EEW
+  int data_emul = (mode == VMEM_INDEX ? vlmul() : eew_log - vsew() + vlmul());
+  if (!vgroup_ok(s, r, data_emul)) return;
+  if (mode == VMEM_INDEX && !vgroup_ok(s, s->isa.rs2, eew_log - vsew() + vlmul())) return;
+  vaddr_t addr = gpr(s->isa.rs1);
+  bool vm = BITS(s->isa.inst.val, 25, 25);
+  // elements misaligned to EEW may cross pages, so they are copied one by one
+  if (mode == VMEM_UNIT && vm && (addr & (eew - 1)) == 0) vmem_unit(s, r, eew_log, addr, store);
+  else vmem_elems(s, r, cpu.vstart, eew_log, mode, addr, stride, eew_log, store);
+  cpu.vstart = 0;
+}
+
+void vec_load(Decode *s, int eew, int mode, word_t stride) { vmem(s, eew, mode, stride, false); }
+void vec_store(Decode *s, int eew, int mode, word_t stride) { vmem(s, eew, mode, stride, true); }
+
+// --- arithmetic ---
+
+/* A kernel computes `bytes' (rounded up to VBYTES) bytes of the result
+ * from the operands `a' (vs2), `b' (vs1, or a scalar broadcast to VBYTES
+ * bytes with `bmask' = 0) and `c' (the old vd). GCC vector types are
+ * used, so each step takes one AVX2 operation, or two SSE operations
+ * for the default clone.
+ */
+#define VBYTES 32
+
+typedef uint8_t  vu8  __attribute__((vector_size(VBYTES)));
+typedef uint16_t vu16 __attribute__((vector_size(VBYTES)));
+typedef uint32_t vu32 __attribute__((vector_size(VBYTES)));
+typedef int8_t   vi8  __attribute__((vector_size(VBYTES)));
+typedef int16_t  vi16 __attribute__((vector_size(VBYTES)));
+typedef int32_t  vi32 __attribute__((vector_size(VBYTES)));
+// twice the width with the same number of elements, for the high half of products
+typedef uint16_t vuw8  __attribute__((vector_size(VBYTES * 2)));
+typedef uint32_t vuw16 __attribute__((vector_size(VBYTES * 2)));
+typedef uint64_t vuw32 __attribute__((vector_size(VBYTES * 2)));
+typedef int16_t  viw8  __attribute__((vector_size(VBYTES * 2)));
+typedef int32_t  viw16 __attribute__((vector_size(VBYTES * 2)));
+typedef int64_t  viw32 __attribute__((vector_size(VBYTES * 2)));
+
+#if defined(__x86_64__) && !defined(__clang__)
+#define VKERNEL_ATTR __attribute__((target_clones("avx2", "default")))
+#else
+#define VKERNEL_ATTR
+#endif
+
+typedef void (*VKernel)(uint8_t *d, const uint8_t *a, const uint8_t *b, const uint8_t *c,
+    uintptr_t bmask, int bytes);
+
+// select `x' where the comparison `cond' holds, otherwise `y'
+#define SEL(cond, x, y) (((TU)(cond) & (x)) | (~(TU)(cond) & (y)))
+#define MULH(a, b, VT, VTW) __builtin_convertvector( \
+  (__builtin_convertvector((VT)(a), VTW) * __builtin_convertvector((VT)(b), VTW)) >> W, VT)
+
+// operation, result of the elements `a', `b' and `c' of W bits
+#define VOP_LIST(f) \
+  f(ADD  , a + b) \
+  f(SUB  , a - b) \
+  f(RSUB , b - a) \
+  f(AND  , a & b) \
+  f(OR   , a | b) \
+  f(XOR  , a ^ b) \
+  f(SLL  , a << (b & (W - 1))) \
+  f(SRL  , a >> (b & (W - 1))) \
+  f(SRA  , (TU)((TS)a >> (TS)(b & (W - 1)))) \
+  f(MINU , SEL(a < b, a, b)) \
+  f(MIN  , SEL((TS)a < (TS)b, a, b)) \
+  f(MAXU , SEL(a > b, a, b)) \
+  f(MAX  , SEL((TS)a > (TS)b, a, b)) \
+  f(MUL  , a * b) \
+  f(MULH , (TU)MULH(a, b, TS, TSW)) \
+  f(MULHU, MULH(a, b, TU, TUW)) \
+  f(MACC , a * b + c) \
+  f(MERGE, b) \
+  f(MSEQ , (TU)(a == b)) \
+  f(MSNE , (TU)(a != b)) \
+  f(MSLTU, (TU)(a < b)) \
+  f(MSLT , (TU)((TS)a < (TS)b)) \
+  f(MSLEU, (TU)(a <= b)) \
+  f(MSLE , (TU)((TS)a <= (TS)b)) \
+  f(MSGTU, (TU)(a > b)) \
+  f(MSGT , (TU)((TS)a > (TS)b))
+
+#define def_VKernel_W(name, w, ...) \
+  VKERNEL_ATTR static void concat4(vkernel_, name, _, w)(uint8_t *d, const uint8_t *pa, \
+      const uint8_t *pb, const uint8_t *pc, uintptr_t bmask, int bytes) { \
+    typedef concat(vu, w) TU; \
+    __attribute__((unused)) typedef concat(vi, w) TS; \
+    __attribute__((unused)) typedef concat(vuw, w) TUW; \
+    __attribute__((unused)) typedef concat(viw, w) TSW; \
+    enum { W = w }; \
+    int i; \
+    for (i = 0; i < bytes; i += VBYTES) { \
+      TU a, b, c, r; \
+      memcpy(&a, pa + i, VBYTES); \
+      memcpy(&b, pb + (i & bmask), VBYTES); \
+      memcpy(&c, pc + i, VBYTES); \
+      r = (__VA_ARGS__); \
+      memcpy(d + i, &r, VBYTES); \
+    } \
+  }
+#define def_VKernel(name, ...) \
+  def_VKernel_W(name, 8, __VA_ARGS__) \
+  def_VKernel_W(name, 16, __VA_ARGS__) \
+  def_VKernel_W(name, 32, __VA_ARGS__)
+MAP(VOP_LIST, def_VKernel)
+
+#define VKERNEL_ENTRY(name, ...) [concat(VOP_, name)] = \
+  { concat(vkernel_, name##_8), concat(vkernel_, name##_16), concat(vkernel_, name##_32) },
+static const VKernel vkernel[NR_VOP][3] = { MAP(VOP_LIST, VKERNEL_ENTRY) };
+
+void vec_arith(Decode *s, int op, bool scalar, word_t x) {
+  if (!vtype_ok(s)) return;
+  int sew = vsew(), lmul = vlmul();
+  int vd = s->isa.rd, vs1 = s->isa.rs1, vs2 = s->isa.rs2;
+  bool vm = BITS(s->isa.inst.val, 25, 25);
+  bool cmp = (op >= VOP_MSEQ); // the result is a mask in a single register
+  if ((!cmp && !vgroup_ok(s, vd, lmul)) || !vgroup_ok(s, vs2, lmul) ||
+      (!scalar && !vgroup_ok(s, vs1, lmul))) return;
+
+  int start = cpu.vstart, end = cpu.vl;
+  cpu.vstart = 0;
+  if (start >= end) return;
+
+  uint8_t bcast[VBYTES] __attribute__((aligned(VBYTES)));
+  if (scalar) {
+    int i;
+    for (i = 0; i < VBYTES; i += (1 << sew)) memcpy(bcast + i, &x, 1 << sew);
+  }
+  const uint8_t *b = (scalar ? bcast : vreg(vs1));
+  uintptr_t bmask = (scalar ? 0 : ~(uintptr_t)0);
+  VKernel k = vkernel[op][sew];
+
+  // the whole group is written in place if no element is kept
+  int bytes = end << sew;
+  if (!cmp && vm && start == 0 && bytes % VBYTES == 0) {
+    k(vreg(vd), vreg(vs2), b, vreg(vd), bmask, bytes);
+    return;
+  }
+
+  static HART_LOCAL uint8_t res[8 * VLENB + VBYTES] __attribute__((aligned(VBYTES)));
+  // the old vd is only read by vmacc, which is not a comparison
+  k(res, vreg(vs2), b, vreg(cmp ? vs2 : vd), bmask, bytes);
+  int i;
+  if (cmp) {
+    uint8_t *m = vreg(vd);
+    for (i = start; i < end; i ++) {
+      if (!vm && !vmask_bit(i)) continue;
+      m[i >> 3] = (m[i >> 3] & ~(1u << (i & 7))) | ((res[i << sew] & 1) << (i & 7));
+    }
+  } else if (vm) {
+    memcpy(vreg(vd) + (start << sew), res + (start << sew), (end - start) << sew);
+  } else {
+    // vmerge takes inactive elements from vs2
+    for (i = start; i < end; i ++) {
+      if (vmask_bit(i)) memcpy(vreg(vd) + (i << sew), res + (i << sew), 1 << sew);
+      else if (op == VOP_MERGE) memcpy(vreg(vd) + (i << sew), vreg(vs2) + (i << sew), 1 << sew);
+    }
+  }
+}
+
+void vec_red(Decode *s, int op) {
+  if (!vtype_ok(s)) return;
+  int sew = vsew();
+  int vd = s->isa.rd, vs1 = s->isa.rs1, vs2 = s->isa.rs2;
+  bool vm = BITS(s->isa.inst.val, 25, 25);
+  if (!vgroup_ok(s, vs2, vlmul())) return;
+  cpu.vstart = 0;
+  if (cpu.vl == 0) return;
+  word_t acc = velem(vs1, 0, sew);
+  int i;
+  for (i = 0; i < cpu.vl; i ++) {
+    if (!vm && !vmask_bit(i)) continue;
+    word_t e = velem(vs2, i, sew);
+    sword_t sacc = vsext(acc, sew), se = vsext(e, sew);
+    switch (op) {
+      case VRED_SUM:  acc += e; break;
+      case VRED_AND:  acc &= e; break;
+      case VRED_OR:   acc |= e; break;
+      case VRED_XOR:  acc ^= e; break;
+      case VRED_MINU: acc = (e < acc ? e : acc); break;
+      case VRED_MIN:  acc = (se < sacc ? e : acc); break;
+      case VRED_MAXU: acc = (e > acc ? e : acc); break;
+      case VRED_MAX:  acc = (se > sacc ? e : acc); break;
+    }
+  }
+  velem_set(vd, 0, sew, acc);
+}
+
+word_t vec_mv_x_s(Decode *s) {
+  if (!vtype_ok(s)) return 0;
+  int sew = vsew();
+  return vsext(velem(s->isa.rs2, 0, sew), sew);
+}
+
+void vec_mv_s_x(Decode *s, word_t x) {
+  if (!vtype_ok(s)) return;
+  if (cpu.vstart < cpu.vl) velem_set(s->isa.rd, 0, vsew(), x);
+  cpu.vstart = 0;
+}
+
+void vec_id(Decode *s) {
+  if (!vtype_ok(s)) return;
+  int sew = vsew();
+  bool vm = BITS(s->isa.inst.val, 25, 25);
+  if (!vgroup_ok(s, s->isa.rd, vlmul())) return;
+  int i;
+  for (i = cpu.vstart; i < cpu.vl; i ++) {
+    if (vm || vmask_bit(i)) velem_set(s->isa.rd, i, sew, i);
+  }
+  cpu.vstart = 0;
+}
+#endif
@@ -15,8 +15,11 @@
 
 #include <memory/host.h>
 #include <memory/paddr.h>
+#include <memory/vaddr.h>
 #include <device/mmio.h>
 #include <isa.h>
+#include <cpu/block.h>
+#include <cpu/cpu.h>
 
 #if   defined(CONFIG_PMEM_MALLOC)
 static uint8_t *pmem = NULL;
@@ -27,13 +30,60 @@ static uint8_t pmem[CONFIG_MSIZE] PG_ALIGN = {};
 uint8_t* guest_to_host(paddr_t paddr) { return pmem + paddr - CONFIG_MBASE; }
 paddr_t host_to_guest(uint8_t *haddr) { return haddr - pmem + CONFIG_MBASE; }
 
+#ifdef CONFIG_PMEM_CODE_PAGE
+// pages which contain instructions held by the decode cache or translated code
+static uint8_t code_page[CONFIG_MSIZE >> PAGE_SHIFT] = {};
+
+static inline uint8_t* code_page_of(paddr_t addr) {
+  return &code_page[(addr - CONFIG_MBASE) >> PAGE_SHIFT];
+}
+
+void pmem_mark_code(paddr_t addr) {
+  uint8_t *p = code_page_of(addr);
+  if (*p) return;
+  *p = 1;
+  // stores to this page should now go through pmem_write(), also on the
+  // other harts, which may have filled their soft TLBs with the page
+  IFDEF(CONFIG_SOFT_TLB, MUXDEF(CONFIG_SMP, smp_soft_tlb_flush(), soft_tlb_flush()));
+}
+
+bool pmem_is_code(paddr_t addr) { return *code_page_of(addr); }
+uint8_t* pmem_code_pages() { return code_page; }
+
+static void code_page_write(paddr_t addr, int len) {
+  IFDEF(CONFIG_DECODE_CACHE, isa_dcache_invalidate(addr, len));
+  IFDEF(CONFIG_ENGINE_BLOCK, block_invalidate(addr, len));
+}
+#endif
+
+void pmem_code_flush() {
+  IFDEF(CONFIG_DECODE_CACHE, isa_dcache_flush());
+  IFDEF(CONFIG_ENGINE_BLOCK, block_flush());
+#if defined(CONFIG_PMEM_CODE_PAGE) && !defined(CONFIG_SMP)
+  // Nothing is cached from pmem now, so stores to the pages which held
+  // instructions go back to the fast path. With SMP, the decode caches of
+  // the other harts may still hold instructions from these pages.
+  memset(code_page, 0, sizeof(code_page));
+#endif
+}
+
 static word_t pmem_read(paddr_t addr, int len) {
   word_t ret = host_read(guest_to_host(addr), len);
   return ret;
 }
 
 static void pmem_write(paddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_SMP, smp_store(guest_to_host(addr), len));
   host_write(guest_to_host(addr), len, data);
+  IFDEF(CONFIG_PMEM_CODE_PAGE,
+      if (unlikely(*code_page_of(addr))) code_page_write(addr, len));
+}
+
+uint8_t* pmem_host_rmw(paddr_t addr, int len) {
+  IFDEF(CONFIG_PMEM_CODE_PAGE,
+      if (unlikely(*code_page_of(addr))) code_page_write(addr, len));
+  IFDEF(CONFIG_SMP, smp_store(guest_to_host(addr), len));
+  return guest_to_host(addr);
 }
 
 static void out_of_bound(paddr_t addr) {
@@ -47,18 +97,42 @@ void init_mem() {
   assert(pmem);
 #endif
   IFDEF(CONFIG_MEM_RANDOM, memset(pmem, rand(), CONFIG_MSIZE));
+  IFDEF(CONFIG_SOFT_TLB, soft_tlb_flush());
   Log("physical memory area [" FMT_PADDR ", " FMT_PADDR "]", PMEM_LEFT, PMEM_RIGHT);
 }
 
-word_t paddr_read(paddr_t addr, int len) {
+static inline word_t paddr_read_untraced(paddr_t addr, int len) {
   if (likely(in_pmem(addr))) return pmem_read(addr, len);
   IFDEF(CONFIG_DEVICE, return mmio_read(addr, len));
   out_of_bound(addr);
   return 0;
 }
 
-void paddr_write(paddr_t addr, int len, word_t data) {
+static inline void paddr_write_untraced(paddr_t addr, int len, word_t data) {
   if (likely(in_pmem(addr))) { pmem_write(addr, len, data); return; }
   IFDEF(CONFIG_DEVICE, mmio_write(addr, len, data); return);
   out_of_bound(addr);
 }
+
+#ifdef CONFIG_MTRACE
+static __attribute__((noinline)) word_t paddr_read_traced(paddr_t addr, int len) {
+  word_t data = paddr_read_untraced(addr, len);
+  mtrace_access(addr, len, false, data);
+  return data;
+}
+
+static __attribute__((noinline)) void paddr_write_traced(paddr_t addr, int len, word_t data) {
+  mtrace_access(addr, len, true, data);
+  paddr_write_untraced(addr, len, data);
+}
+#endif
+
+word_t paddr_read(paddr_t addr, int len) {
+  IFDEF(CONFIG_MTRACE, if (unlikely(mtrace_hit(addr))) return paddr_read_traced(addr, len));
+  return paddr_read_untraced(addr, len);
+}
+
+void paddr_write(paddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_MTRACE, if (unlikely(mtrace_hit(addr))) { paddr_write_traced(addr, len, data); return; });
+  paddr_write_untraced(addr, len, data);
+}
@@ -15,19 +15,182 @@
 
 #include <isa.h>
 #include <memory/paddr.h>
+#include <memory/vaddr.h>
+#include <device/map.h>
+#include <cpu/cpu.h>
 
-/**
- * Now virtual address is the same as physical address
- */
+static const char *type_name[] = {
+  [MEM_TYPE_IFETCH] = "ifetch", [MEM_TYPE_READ] = "read", [MEM_TYPE_WRITE] = "write",
+};
+
+static inline bool cross_page(vaddr_t addr, int len) {
+  return (addr & PAGE_MASK) + len > PAGE_SIZE;
+}
+
+// The physical address of `addr', which should not cross a page.
+// A page fault does not return if the ISA raises an exception for it.
+static paddr_t translate(vaddr_t addr, int len, int type) {
+  int ret = isa_mmu_check(addr, len, type);
+  if (ret == MMU_DIRECT) return addr;
+  if (ret == MMU_TRANSLATE) {
+    paddr_t pg_base = isa_mmu_translate(addr, len, type);
+    if (likely((pg_base & PAGE_MASK) == MEM_RET_OK)) return pg_base | (addr & PAGE_MASK);
+  }
+  word_t NO = isa_mmu_fault(addr, type);
+  if (NO != INTR_EMPTY) longjmp_exception(NO);
+  panic("page fault: %s at vaddr = " FMT_WORD ", len = %d, pc = " FMT_WORD,
+      type_name[type], addr, len, cpu.pc);
+  return 0;
+}
+
+bool vaddr_code_cacheable(vaddr_t pc) {
+  return in_pmem(pc) && (isa_mmu_check(pc, 4, MEM_TYPE_IFETCH) == MMU_DIRECT ||
+      translate(pc, 4, MEM_TYPE_IFETCH) == pc);
+}
+
+void* vaddr_host_rmw(vaddr_t addr, int len) {
+#ifdef CONFIG_SOFT_TLB
+  SoftTLBEntry *e = soft_tlb_entry(addr);
+  if (soft_tlb_hit(e, addr, len, MEM_TYPE_WRITE)) {
+    void *haddr = (void *)(e->addend + addr);
+    IFDEF(CONFIG_SMP, smp_store(haddr, len));
+    return haddr;
+  }
+#endif
+  if (cross_page(addr, len)) return NULL;
+  paddr_t paddr = translate(addr, len, MEM_TYPE_WRITE);
+  IFDEF(CONFIG_MTRACE, if (mtrace_page(paddr)) return NULL);
+  return (in_pmem(paddr) ? pmem_host_rmw(paddr, len) : NULL);
+}
+
+void* vaddr_host_read(vaddr_t addr, int len) {
+  if (cross_page(addr, len)) return NULL;
+#ifdef CONFIG_SOFT_TLB
+  SoftTLBEntry *e = soft_tlb_entry(addr);
+  if (e->tag[MEM_TYPE_READ] == (addr & ~PAGE_MASK)) return (void *)(e->addend + addr);
+#endif
+  paddr_t paddr = translate(addr, len, MEM_TYPE_READ);
+  IFDEF(CONFIG_MTRACE, if (mtrace_page(paddr)) return NULL);
+  return (in_pmem(paddr) ? guest_to_host(paddr) : NULL);
+}
+
+#ifdef CONFIG_SOFT_TLB
+HART_LOCAL SoftTLBEntry soft_tlb[CONFIG_SOFT_TLB_SIZE];
+static_assert((CONFIG_SOFT_TLB_SIZE & (CONFIG_SOFT_TLB_SIZE - 1)) == 0,
+    "size of the software TLB should be a power of 2");
+
+void soft_tlb_flush() {
+  int i, t;
+  for (i = 0; i < CONFIG_SOFT_TLB_SIZE; i ++) {
+    for (t = 0; t < 3; t ++) {
+      soft_tlb[i].tag[t] = soft_tlb[i].io_tag[t] = SOFT_TLB_INVALID;
+    }
+  }
+}
+
+// Fill the tag of `type' in the entry of `addr' which is mapped to
+// `paddr', after dropping the tags of other pages. Stores to pages
+// holding cached or translated instructions always go to the slow path,
+// so that the instructions are dropped by paddr_write(). So do all
+// accesses to the pages traced by the memory tracer.
+static void soft_tlb_fill(SoftTLBEntry *e, vaddr_t addr, paddr_t paddr, int type) {
+  IFDEF(CONFIG_MTRACE, if (mtrace_page(paddr)) return);
+  vaddr_t page = addr & ~PAGE_MASK;
+  paddr_t ppage = paddr & ~PAGE_MASK;
+  int t;
+  if (in_pmem(paddr)) {
+    for (t = 0; t < 3; t ++) {
+      if (e->tag[t] != page) e->tag[t] = SOFT_TLB_INVALID;
+    }
+    if (type == MEM_TYPE_WRITE && MUXDEF(CONFIG_PMEM_CODE_PAGE, pmem_is_code(paddr), false)) return;
+    e->tag[type] = page;
+    e->addend = (uintptr_t)guest_to_host(ppage) - page;
+  } else {
+    for (t = 0; t < 3; t ++) {
+      if (e->io_tag[t] != page) e->io_tag[t] = SOFT_TLB_INVALID;
+    }
+    e->io_tag[type] = page;
+    e->io_paddr = ppage;
+    e->io_map = MUXDEF(CONFIG_DEVICE, mmio_map_of_page(ppage), NULL);
+  }
+}
+
+word_t vaddr_read_slow(vaddr_t addr, int len, int type) {
+  SoftTLBEntry *e = soft_tlb_entry(addr);
+  paddr_t paddr;
+  if (e->io_tag[type] == (addr & ~PAGE_MASK)) {
+    paddr = e->io_paddr | (addr & PAGE_MASK);
+  } else {
+    if (isa_mmu_check(addr, len, type) != MMU_DIRECT && cross_page(addr, len)) {
+      word_t ret = 0;
+      int i;
+      for (i = 0; i < len; i ++) ret |= vaddr_read_slow(addr + i, 1, type) << (i * 8);
+      return ret;
+    }
+    paddr = translate(addr, len, type);
+    soft_tlb_fill(e, addr, paddr, type);
+    if (soft_tlb_hit(e, addr, len, type)) return host_read((void *)(e->addend + addr), len);
+    if (e->io_tag[type] != (addr & ~PAGE_MASK)) return paddr_read(paddr, len); // misaligned
+  }
+  if (e->io_map != NULL) {
+    IFDEF(CONFIG_DIFFTEST, difftest_skip_ref());
+    return map_read(paddr, len, e->io_map);
+  }
+  return paddr_read(paddr, len);
+}
+
+void vaddr_write_slow(vaddr_t addr, int len, word_t data) {
+  SoftTLBEntry *e = soft_tlb_entry(addr);
+  paddr_t paddr;
+  if (e->io_tag[MEM_TYPE_WRITE] == (addr & ~PAGE_MASK)) {
+    paddr = e->io_paddr | (addr & PAGE_MASK);
+  } else {
+    if (isa_mmu_check(addr, len, MEM_TYPE_WRITE) != MMU_DIRECT && cross_page(addr, len)) {
+      int i;
+      for (i = 0; i < len; i ++) vaddr_write_slow(addr + i, 1, data >> (i * 8));
+      return;
+    }
+    paddr = translate(addr, len, MEM_TYPE_WRITE);
+    soft_tlb_fill(e, addr, paddr, MEM_TYPE_WRITE);
+    if (e->io_tag[MEM_TYPE_WRITE] != (addr & ~PAGE_MASK)) { paddr_write(paddr, len, data); return; }
+  }
+  if (e->io_map != NULL) {
+    IFDEF(CONFIG_DIFFTEST, difftest_skip_ref());
+    map_write(paddr, len, data, e->io_map);
+    return;
+  }
+  paddr_write(paddr, len, data);
+}
+#else
+static word_t vaddr_read_type(vaddr_t addr, int len, int type) {
+  if (isa_mmu_check(addr, len, type) == MMU_DIRECT) return paddr_read(addr, len);
+  if (cross_page(addr, len)) {
+    word_t ret = 0;
+    int i;
+    for (i = 0; i < len; i ++) ret |= vaddr_read_type(addr + i, 1, type) << (i * 8);
+    return ret;
+  }
+  return paddr_read(translate(addr, len, type), len);
+}
 
 word_t vaddr_ifetch(vaddr_t addr, int len) {
-  return paddr_read(addr, len);
+  return vaddr_read_type(addr, len, MEM_TYPE_IFETCH);
 }
 
 word_t vaddr_read(vaddr_t addr, int len) {
-  return paddr_read(addr, len);
+  return vaddr_read_type(addr, len, MEM_TYPE_READ);
 }
 
 void vaddr_write(vaddr_t addr, int len, word_t data) {
-  paddr_write(addr, len, data);
+  if (isa_mmu_check(addr, len, MEM_TYPE_WRITE) == MMU_DIRECT) {
+    paddr_write(addr, len, data);
+    return;
+  }
+  if (cross_page(addr, len)) {
+    int i;
+    for (i = 0; i < len; i ++) vaddr_write(addr + i, 1, data >> (i * 8));
+    return;
+  }
+  paddr_write(translate(addr, len, MEM_TYPE_WRITE), len, data);
 }
+#endif
@@ -17,10 +17,13 @@
 #include <memory/paddr.h>
 
 void init_rand();
+void init_time();
 void init_log(const char *log_file);
 void init_mem();
 void init_difftest(char *ref_so_file, long img_size, int port);
 void init_device();
+void init_dbt();
+void init_smp();
 void init_sdb();
 void init_disasm(const char *triple);
 
@@ -43,6 +46,10 @@ void sdb_set_batch_mode();
 
 static char *log_file = NULL;
 static char *diff_so_file = NULL;
+static char *itrace_file = NULL;
+static char *elf_file = NULL;
+static char *profile_file = NULL;
+static char *mtrace_file = NULL;
 static char *img_file = NULL;
 static int difftest_port = 1234;
 
@@ -74,23 +81,42 @@ static int parse_args(int argc, char *argv[]) {
     {"log"      , required_argument, NULL, 'l'},
     {"diff"     , required_argument, NULL, 'd'},
     {"port"     , required_argument, NULL, 'p'},
+    {"time"     , required_argument, NULL, 't'},
+    {"itrace"   , required_argument, NULL, 'i'},
+    {"elf"      , required_argument, NULL, 'e'},
+    {"profile"  , required_argument, NULL, 'P'},
+    {"mtrace"   , required_argument, NULL, 'm'},
     {"help"     , no_argument      , NULL, 'h'},
     {0          , 0                , NULL,  0 },
   };
   int o;
-  while ( (o = getopt_long(argc, argv, "-bhl:d:p:", table, NULL)) != -1) {
+  while ( (o = getopt_long(argc, argv, "-bhl:d:p:t:i:e:P:m:", table, NULL)) != -1) {
     switch (o) {
       case 'b': sdb_set_batch_mode(); break;
       case 'p': sscanf(optarg, "%d", &difftest_port); break;
       case 'l': log_file = optarg; break;
       case 'd': diff_so_file = optarg; break;
+      case 'i': itrace_file = optarg; break;
+      case 'e': elf_file = optarg; break;
+      case 'P': profile_file = optarg; break;
+      case 'm': mtrace_file = optarg; break;
       case 1: img_file = optarg; return 0;
+      case 't':
+        if (strcmp(optarg, "virtual") == 0) { set_virtual_time(true); break; }
+        if (strcmp(optarg, "real") == 0) { set_virtual_time(false); break; }
+        printf("Unknown time mode '%s'\n\n", optarg);
+        // fall through
       default:
         printf("Usage: %s [OPTION...] IMAGE [args]\n\n", argv[0]);
         printf("\t-b,--batch              run with batch mode\n");
         printf("\t-l,--log=FILE           output log to FILE\n");
         printf("\t-d,--diff=REF_SO        run DiffTest with reference REF_SO\n");
         printf("\t-p,--port=PORT          run DiffTest with port PORT\n");
+        printf("\t-t,--time=real|virtual  take the guest time from the host clock or the instruction count\n");
+        printf("\t-i,--itrace=FILE        write the binary instruction trace to FILE\n");
+        printf("\t-e,--elf=FILE           read the symbols of the guest from FILE\n");
+        printf("\t-P,--profile=FILE       write the samples of the profiler to FILE\n");
+        printf("\t-m,--mtrace=FILE        write the memory access trace to FILE\n");
         printf("\n");
         exit(0);
     }
@@ -110,33 +136,51 @@ void init_monitor(int argc, char *argv[]) {
   /* Open the log file. */
   init_log(log_file);
 
+  /* Start the host clock. */
+  init_time();
+
   /* Initialize memory. */
   init_mem();
 
   /* Initialize devices. */
   IFDEF(CONFIG_DEVICE, init_device());
 
+  /* Start tracing memory accesses before they are cached. */
+  IFDEF(CONFIG_MTRACE, init_mtrace(mtrace_file));
+
   /* Perform ISA dependent initialization. */
   init_isa();
 
   /* Load the image to memory. This will overwrite the built-in image. */
   long img_size = load_img();
 
+  /* Load the symbols of the guest. */
+  IFDEF(CONFIG_ELF_SYMBOL, init_elf(elf_file));
+  IFDEF(CONFIG_FTRACE, init_ftrace());
+  IFDEF(CONFIG_PROFILER, init_profiler(profile_file));
+
+  /* Initialize the binary translator. */
+  IFDEF(CONFIG_ENGINE_DBT, init_dbt());
+
+  /* Start the other harts. */
+  IFDEF(CONFIG_SMP, init_smp());
+
   /* Initialize differential testing. */
   init_difftest(diff_so_file, img_size, difftest_port);
 
   /* Initialize the simple debugger. */
   init_sdb();
 
-#ifndef CONFIG_ISA_loongarch32r
-  IFDEF(CONFIG_ITRACE, init_disasm(
+#if (defined(CONFIG_ITRACE) || defined(CONFIG_IQUEUE)) && !defined(CONFIG_ISA_loongarch32r)
+  const char *triple =
     MUXDEF(CONFIG_ISA_x86,     "i686",
     MUXDEF(CONFIG_ISA_mips32,  "mipsel",
     MUXDEF(CONFIG_ISA_riscv,
       MUXDEF(CONFIG_RV64,      "riscv64",
                                "riscv32"),
-                               "bad"))) "-pc-linux-gnu"
-  ));
+                               "bad"))) "-pc-linux-gnu";
+  init_disasm(triple);
+  IFDEF(CONFIG_ITRACE_BINARY, init_itrace(itrace_file, triple));
 #endif
 
   /* Display welcome message. */
@@ -153,6 +197,7 @@ static long load_img() {
 
 void am_init_monitor() {
   init_rand();
+  init_time();
   init_mem();
   init_isa();
   load_img();
@@ -221,6 +221,7 @@ static int cmd_help(char *args) {
 }
 
 void sdb_set_batch_mode() { is_batch_mode = true; }
+bool sdb_is_batch_mode() { return is_batch_mode; }
 
 void sdb_mainloop() {
   if (is_batch_mode) {
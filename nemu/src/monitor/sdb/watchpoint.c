@@ -82,6 +82,8 @@ void free_wp(int no) {
   Assert(0, "Watchpoint not found.");
 }
 
+bool wp_in_use() { return head != NULL; }
+
 bool polling_wp() {
   WP *wp = head;
   bool changed = false;
@@ -13,6 +13,8 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
+#include <generated/autoconf.h>
+
 #if defined(__GNUC__) && !defined(__clang__)
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
@@ -72,6 +74,14 @@ extern "C" void init_disasm(const char *triple) {
     gSTI->ApplyFeatureFlag("+c");
     gSTI->ApplyFeatureFlag("+f");
     gSTI->ApplyFeatureFlag("+d");
+#if defined(CONFIG_RV_ZB) && LLVM_VERSION_MAJOR >= 14
+    gSTI->ApplyFeatureFlag("+zba");
+    gSTI->ApplyFeatureFlag("+zbb");
+    gSTI->ApplyFeatureFlag("+zbs");
+#endif
+#if defined(CONFIG_RV_V) && LLVM_VERSION_MAJOR >= 14
+    gSTI->ApplyFeatureFlag("+v");
+#endif
   }
   gMII = target->createMCInstrInfo();
   gMRI = target->createMCRegInfo(gTriple);
@@ -0,0 +1,164 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <common.h>
+#include <memory/paddr.h>
+
+#ifdef CONFIG_FTRACE
+/* The function tracer. The ISA reports the calls, the returns and the
+ * other jumps, and the functions are tracked on a shadow stack. A jump
+ * without link to the entry of another function is a tail call, which
+ * replaces the frame on the top.
+ */
+
+#define STACK_DEPTH 4096
+#define NR_PROFILE_SHOW 30
+
+extern HART_LOCAL uint64_t g_nr_guest_inst;
+
+typedef struct {
+  int fn;             // index of the symbol, or nr_fn for unknown code
+  uint64_t start;     // g_nr_guest_inst when it is called
+  uint64_t nr_child;  // instructions executed by the functions it calls
+} Frame;
+
+static Frame stack[STACK_DEPTH];
+static int depth = 0;  // may exceed STACK_DEPTH, when the frames above are not kept
+static int nr_fn = 0;
+
+static int find_fn(vaddr_t addr) {
+  int fn = symbol_find(addr);
+  return (fn < 0 ? nr_fn : fn);
+}
+
+static const char *fn_name(int fn) {
+  return (fn < nr_fn ? symbol_get(fn)->name : "???");
+}
+
+#ifdef CONFIG_FTRACE_PROFILE
+typedef struct {
+  uint64_t nr_call, inclusive, exclusive;
+  int active;  // frames on the stack, so that recursion is counted once in `inclusive'
+} Profile;
+
+static Profile *profile = NULL;
+#endif
+
+static void push(vaddr_t pc, vaddr_t target) {
+  int fn = find_fn(target);
+  IFDEF(CONFIG_FTRACE_LOG, log_write("%*s" FMT_WORD ": call [%s@" FMT_WORD "]\n",
+        depth * 2, "", pc, fn_name(fn), target));
+  if (depth < STACK_DEPTH) {
+    stack[depth] = (Frame) { .fn = fn, .start = g_nr_guest_inst, .nr_child = 0 };
+#ifdef CONFIG_FTRACE_PROFILE
+    profile[fn].nr_call ++;
+    profile[fn].active ++;
+#endif
+  }
+  depth ++;
+}
+
+static void pop(vaddr_t pc) {
+  if (depth == 0) return;  // returned from where it is not traced
+  depth --;
+  if (depth >= STACK_DEPTH) return;
+  Frame *f = &stack[depth];
+  IFDEF(CONFIG_FTRACE_LOG, log_write("%*s" FMT_WORD ": ret  [%s]\n", depth * 2, "", pc, fn_name(f->fn)));
+#ifdef CONFIG_FTRACE_PROFILE
+  uint64_t nr = g_nr_guest_inst - f->start;
+  Profile *p = &profile[f->fn];
+  p->exclusive += nr - f->nr_child;
+  if (-- p->active == 0) p->inclusive += nr;
+  if (depth > 0) stack[depth - 1].nr_child += nr;
+#endif
+}
+
+void ftrace_call(vaddr_t pc, vaddr_t target) { push(pc, target); }
+
+void ftrace_ret(vaddr_t pc) { pop(pc); }
+
+void ftrace_jump(vaddr_t pc, vaddr_t target) {
+  if (depth == 0 || depth > STACK_DEPTH) return;
+  // a jump within the function is the common case, and needs no search
+  int cur = stack[depth - 1].fn;
+  if (cur < nr_fn) {
+    const Symbol *s = symbol_get(cur);
+    if (target - s->addr < s->size && target != s->addr) return;
+  }
+  int fn = symbol_find(target);
+  if (fn < 0 || symbol_get(fn)->addr != target) return;
+  pop(pc);
+  push(pc, target);
+}
+
+// Fill `fn' with the functions on the stack from the outermost one, and
+// return the number of them. An unknown function is -1.
+int ftrace_backtrace(int *fn, int max) {
+  int i;
+  int n = (depth < STACK_DEPTH ? depth : STACK_DEPTH);
+  if (n > max) n = max;
+  for (i = 0; i < n; i ++) fn[i] = (stack[i].fn < nr_fn ? stack[i].fn : -1);
+  return n;
+}
+
+void init_ftrace() {
+  nr_fn = symbol_nr();
+  if (nr_fn == 0) Log("No symbols are given by --elf, the functions are shown as ???");
+  IFDEF(CONFIG_FTRACE_PROFILE, profile = calloc(nr_fn + 1, sizeof(Profile)));
+  // the code at the reset vector is called by no one
+  push(RESET_VECTOR, RESET_VECTOR);
+}
+
+#ifdef CONFIG_FTRACE_PROFILE
+static int profile_cmp(const void *a, const void *b) {
+  uint64_t x = ((const Profile *)a)->exclusive, y = ((const Profile *)b)->exclusive;
+  return (x < y) - (x > y);
+}
+
+// Print the profile with the frames still on the stack, which are left intact.
+void ftrace_statistic() {
+  int i;
+  // an assertion may fail before init_ftrace()
+  if (profile == NULL) return;
+  Profile *p = malloc((nr_fn + 1) * sizeof(Profile));
+  memcpy(p, profile, (nr_fn + 1) * sizeof(Profile));
+  int n = (depth < STACK_DEPTH ? depth : STACK_DEPTH);
+  for (i = 0; i < n; i ++) {
+    Frame *f = &stack[i];
+    uint64_t nr = g_nr_guest_inst - f->start;
+    uint64_t nr_child = f->nr_child + (i + 1 < n ? g_nr_guest_inst - stack[i + 1].start : 0);
+    p[f->fn].exclusive += nr - nr_child;
+    // the outermost frame of the function counts
+    if (p[f->fn].active > 0) { p[f->fn].inclusive += nr; p[f->fn].active = 0; }
+  }
+  // keep the index of the function in `active' for sorting
+  for (i = 0; i <= nr_fn; i ++) p[i].active = i;
+  qsort(p, nr_fn + 1, sizeof(Profile), profile_cmp);
+
+  Log("function profile, in guest instructions:");
+  printf("%12s %6s %16s %6s %16s  %s\n", "calls", "excl%", "exclusive", "incl%", "inclusive", "function");
+  uint64_t total = g_nr_guest_inst > 0 ? g_nr_guest_inst : 1;
+  for (i = 0; i <= nr_fn && i < NR_PROFILE_SHOW && p[i].exclusive > 0; i ++) {
+    printf("%12" PRIu64 " %5.1f%% %16" PRIu64 " %5.1f%% %16" PRIu64 "  %s\n", p[i].nr_call,
+        p[i].exclusive * 100.0 / total, p[i].exclusive,
+        p[i].inclusive * 100.0 / total, p[i].inclusive, fn_name(p[i].active));
+  }
+  int rest = 0;
+  for (; i <= nr_fn; i ++) rest += (p[i].exclusive > 0);
+  if (rest > 0) printf("... %d more functions\n", rest);
+  free(p);
+}
+#endif
+#endif
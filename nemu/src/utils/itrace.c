@@ -0,0 +1,68 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <common.h>
+#include <itrace-def.h>
+
+#ifdef CONFIG_ITRACE_BINARY
+/* The binary instruction trace. A record costs a few stores to a buffer,
+ * which is written to the file when it is full, instead of formatting and
+ * disassembling each instruction while running.
+ */
+
+typedef struct {
+  vaddr_t pc;
+  uint32_t inst;
+  IFDEF(CONFIG_ITRACE_BINARY_RD, word_t rd);
+} __attribute__((packed)) ItraceRecord;
+
+static FILE *itrace_fp = NULL;
+static ItraceRecord itrace_buf[CONFIG_ITRACE_BUF_SIZE];
+static int itrace_nr = 0;
+
+void init_itrace(const char *file, const char *triple) {
+  if (file == NULL) return;
+  itrace_fp = fopen(file, "wb");
+  Assert(itrace_fp, "Can not open '%s'", file);
+  ItraceHeader h = {
+    .pc_size = sizeof(vaddr_t),
+    .rd_size = MUXDEF(CONFIG_ITRACE_BINARY_RD, sizeof(word_t), 0),
+    .rec_size = sizeof(ItraceRecord),
+  };
+  memcpy(h.magic, ITRACE_MAGIC, sizeof(h.magic));
+  Assert(strlen(triple) < sizeof(h.triple), "triple '%s' is too long", triple);
+  strcpy(h.triple, triple);
+  int ret = fwrite(&h, sizeof(h), 1, itrace_fp);
+  assert(ret == 1);
+  Log("Binary instruction trace is written to %s", file);
+}
+
+void itrace_flush() {
+  if (itrace_nr == 0) return;
+  int ret = fwrite(itrace_buf, sizeof(itrace_buf[0]), itrace_nr, itrace_fp);
+  assert(ret == itrace_nr);
+  fflush(itrace_fp);
+  itrace_nr = 0;
+}
+
+void itrace_write(vaddr_t pc, uint32_t inst, word_t rd) {
+  if (itrace_fp == NULL) return;
+  ItraceRecord *r = &itrace_buf[itrace_nr];
+  r->pc = pc;
+  r->inst = inst;
+  IFDEF(CONFIG_ITRACE_BINARY_RD, r->rd = rd);
+  if (++ itrace_nr == CONFIG_ITRACE_BUF_SIZE) itrace_flush();
+}
+#endif
@@ -0,0 +1,129 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/block.h>
+#include <memory/paddr.h>
+#include <memory/vaddr.h>
+#include <mtrace-def.h>
+
+#ifdef CONFIG_MTRACE
+/* The memory access tracer. paddr_read() and paddr_write() only check
+ * the range covering all windows, and the accesses in it are matched
+ * against each window here. The records are buffered, and written to
+ * the file when the buffer is full.
+ */
+
+#define MAX_WINDOW 16
+
+typedef struct {
+  vaddr_t pc;
+  paddr_t addr;
+  word_t data;
+  uint8_t len;
+} __attribute__((packed)) MtraceRecord;
+
+typedef struct {
+  paddr_t lo, hi;  // inclusive
+} Window;
+
+paddr_t mtrace_lo = 0, mtrace_span = 0;
+static Window window[MAX_WINDOW];
+static int nr_window = 0;
+
+static FILE *mtrace_fp = NULL;
+static MtraceRecord mtrace_buf[CONFIG_MTRACE_BUF_SIZE];
+static int mtrace_nr = 0;
+
+static void parse_windows(const char *str) {
+  const char *p = str;
+  while (*p != '\0') {
+    char *end;
+    paddr_t lo = strtoull(p, &end, 0);
+    Assert(*end == '-', "bad window '%s' in MTRACE_RANGE", p);
+    paddr_t hi = strtoull(end + 1, &end, 0);
+    Assert((*end == ',' || *end == '\0') && lo <= hi, "bad window '%s' in MTRACE_RANGE", p);
+    Assert(nr_window < MAX_WINDOW, "too many windows in MTRACE_RANGE");
+    window[nr_window ++] = (Window) { lo, hi };
+    p = (*end == ',' ? end + 1 : end);
+  }
+}
+
+void init_mtrace(const char *file) {
+  int i;
+  if (file == NULL) return;
+  parse_windows(CONFIG_MTRACE_RANGE);
+  if (nr_window == 0) return;
+  mtrace_fp = fopen(file, "wb");
+  Assert(mtrace_fp, "Can not open '%s'", file);
+  MtraceHeader h = {
+    .pc_size = sizeof(vaddr_t), .addr_size = sizeof(paddr_t),
+    .data_size = sizeof(word_t), .rec_size = sizeof(MtraceRecord),
+  };
+  memcpy(h.magic, MTRACE_MAGIC, sizeof(h.magic));
+  int ret = fwrite(&h, sizeof(h), 1, mtrace_fp);
+  assert(ret == 1);
+
+  paddr_t lo = window[0].lo, hi = window[0].hi;
+  for (i = 1; i < nr_window; i ++) {
+    if (window[i].lo < lo) lo = window[i].lo;
+    if (window[i].hi > hi) hi = window[i].hi;
+  }
+  mtrace_lo = lo;
+  // the span may wrap to 0 if the windows cover the whole address space
+  mtrace_span = (hi - lo + 1 == 0 ? (paddr_t)-1 : hi - lo + 1);
+  Log("Memory accesses to %s are traced to %s", CONFIG_MTRACE_RANGE, file);
+}
+
+void mtrace_flush() {
+  if (mtrace_nr == 0) return;
+  int ret = fwrite(mtrace_buf, sizeof(mtrace_buf[0]), mtrace_nr, mtrace_fp);
+  assert(ret == mtrace_nr);
+  fflush(mtrace_fp);
+  mtrace_nr = 0;
+}
+
+void mtrace_access(paddr_t addr, int len, bool write, word_t data) {
+  int i;
+  for (i = 0; i < nr_window; i ++) {
+    if (addr >= window[i].lo && addr <= window[i].hi) break;
+  }
+  if (i == nr_window) return;
+  MtraceRecord *r = &mtrace_buf[mtrace_nr];
+  r->pc = MUXDEF(CONFIG_ENGINE_BLOCK, block_pc(), cpu.pc);
+  r->addr = addr;
+  r->data = data;
+  r->len = len | (write ? MTRACE_WRITE : 0);
+  if (++ mtrace_nr == CONFIG_MTRACE_BUF_SIZE) mtrace_flush();
+}
+
+bool mtrace_page(paddr_t addr) {
+  int i;
+  paddr_t page = addr & ~(paddr_t)PAGE_MASK;
+  for (i = 0; i < nr_window; i ++) {
+    if (window[i].lo <= page + PAGE_MASK && window[i].hi >= page) return true;
+  }
+  return false;
+}
+
+bool mtrace_pmem() {
+  int i;
+  for (i = 0; i < nr_window; i ++) {
+    if (window[i].lo <= PMEM_RIGHT && window[i].hi >= PMEM_LEFT) return true;
+  }
+  return false;
+}
+#endif
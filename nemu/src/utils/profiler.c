@@ -0,0 +1,170 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+
+#ifdef CONFIG_PROFILER
+#include <signal.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/* The sampling profiler. A sample is the PC of the guest, with the call
+ * stack of the function tracer if CONFIG_PROFILER_STACK. The samples are
+ * taken between runs of instructions, either by splitting the runs in
+ * execute() or through the interrupt check on SIGPROF, so the
+ * instructions do not check for them. They are written as collapsed
+ * stacks, one line of "outer;...;inner count" for each distinct stack.
+ */
+
+#define MAX_DEPTH 128
+
+extern HART_LOCAL uint64_t g_nr_guest_inst;
+
+static FILE *profile_fp = NULL;
+// samples in a row, each as the number of frames, the frames and the PC
+static vaddr_t *samples = NULL;
+static size_t nr_word = 0, max_word = 0;
+static uint64_t nr_sample = 0;
+
+static void sample() {
+  int i;
+  int fn[MAX_DEPTH];
+  int n = MUXDEF(CONFIG_PROFILER_STACK, ftrace_backtrace(fn, MAX_DEPTH), 0);
+  if (nr_word + n + 2 > max_word) {
+    max_word = (max_word == 0 ? 65536 : max_word * 2);
+    samples = realloc(samples, max_word * sizeof(vaddr_t));
+    assert(samples);
+  }
+  samples[nr_word ++] = n;
+  for (i = 0; i < n; i ++) samples[nr_word ++] = fn[i];
+  samples[nr_word ++] = cpu.pc;
+  nr_sample ++;
+}
+
+#ifdef CONFIG_PROFILER_INST
+static uint64_t next_sample = 0;
+
+// The interval is randomized around CONFIG_PROFILER_INTERVAL, so that
+// it does not keep sampling the same point of a loop.
+static uint64_t interval() {
+  static uint32_t x = 2463534242u;
+  x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+  return CONFIG_PROFILER_INTERVAL / 2 + x % CONFIG_PROFILER_INTERVAL + 1;
+}
+
+// Take a sample if it is time, and return the number of instructions
+// to run before the next one, at most `n'.
+uint64_t profiler_tick(uint64_t n) {
+  if (profile_fp == NULL) return n;
+  if (g_nr_guest_inst >= next_sample) {
+    if (g_nr_guest_inst > 0) sample();
+    next_sample = g_nr_guest_inst + interval();
+  }
+  uint64_t m = next_sample - g_nr_guest_inst;
+  return (m < n ? m : n);
+}
+#else
+static volatile bool sample_pending = false;
+
+static void profiler_sig_handler(int signum) {
+  sample_pending = true;
+  g_intr_check = true;
+}
+
+// Take the sample requested by SIGPROF, if any. It is called with the
+// check of interrupts, at the boundary of instructions.
+void profiler_check() {
+  if (!sample_pending) return;
+  sample_pending = false;
+  sample();
+}
+#endif
+
+void init_profiler(const char *file) {
+  if (file == NULL) {
+    Log("No file is given by --profile, the profiler is off");
+    return;
+  }
+  profile_fp = fopen(file, "w");
+  Assert(profile_fp, "Can not open '%s'", file);
+  Log("Profile is written to %s", file);
+#ifdef CONFIG_PROFILER_SIGPROF
+  struct sigaction s;
+  memset(&s, 0, sizeof(s));
+  s.sa_handler = profiler_sig_handler;
+  s.sa_flags = SA_RESTART;
+  int ret = sigaction(SIGPROF, &s, NULL);
+  Assert(ret == 0, "Can not set signal handler");
+
+  struct itimerval it = {};
+  it.it_value.tv_sec = CONFIG_PROFILER_INTERVAL / 1000000;
+  it.it_value.tv_usec = CONFIG_PROFILER_INTERVAL % 1000000;
+  it.it_interval = it.it_value;
+  ret = setitimer(ITIMER_PROF, &it, NULL);
+  Assert(ret == 0, "Can not set timer");
+#endif
+}
+
+static int str_cmp(const void *a, const void *b) {
+  return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static const char *fn_name(int fn) {
+  return (fn < 0 ? "???" : symbol_get(fn)->name);
+}
+
+// Write the samples as collapsed stacks, replacing what is written before.
+void profiler_dump() {
+  uint64_t i, j;
+  int k;
+  if (profile_fp == NULL) return;
+  char **stacks = malloc(nr_sample * sizeof(char *));
+  assert(stacks);
+  size_t w = 0;
+  for (i = 0; i < nr_sample; i ++) {
+    int n = samples[w ++];
+    char *buf = NULL;
+    size_t size = 0;
+    FILE *s = open_memstream(&buf, &size);
+    for (k = 0; k < n; k ++) fprintf(s, "%s;", fn_name(samples[w ++]));
+    vaddr_t pc = samples[w ++];
+    // the innermost frame is named by the PC, unless the stack already ends with it
+    int leaf = symbol_find(pc);
+    if (leaf < 0) fprintf(s, FMT_WORD, pc);
+    else if (n == 0 || (int)samples[w - 2] != leaf) fprintf(s, "%s", fn_name(leaf));
+    fclose(s);
+    if (size > 0 && buf[size - 1] == ';') buf[size - 1] = '\0';
+    stacks[i] = buf;
+  }
+  qsort(stacks, nr_sample, sizeof(char *), str_cmp);
+
+  rewind(profile_fp);
+  int ret = ftruncate(fileno(profile_fp), 0);
+  assert(ret == 0);
+  uint64_t nr_stack = 0;
+  for (i = 0; i < nr_sample; ) {
+    j = i + 1;
+    while (j < nr_sample && strcmp(stacks[i], stacks[j]) == 0) j ++;
+    fprintf(profile_fp, "%s %" PRIu64 "\n", stacks[i], j - i);
+    nr_stack ++;
+    i = j;
+  }
+  fflush(profile_fp);
+  for (i = 0; i < nr_sample; i ++) free(stacks[i]);
+  free(stacks);
+  Log("profiler: %" PRIu64 " samples in %" PRIu64 " stacks", nr_sample, nr_stack);
+}
+#endif
@@ -0,0 +1,108 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <common.h>
+
+#ifdef CONFIG_ELF_SYMBOL
+#include <elf.h>
+
+/* The function symbols of the guest ELF, sorted by address in a flat
+ * array, so that the function containing an address is found by binary
+ * search.
+ */
+
+#define Elf_Ehdr MUXDEF(CONFIG_ISA64, Elf64_Ehdr, Elf32_Ehdr)
+#define Elf_Shdr MUXDEF(CONFIG_ISA64, Elf64_Shdr, Elf32_Shdr)
+#define Elf_Sym  MUXDEF(CONFIG_ISA64, Elf64_Sym , Elf32_Sym )
+#define ELF_ST_TYPE MUXDEF(CONFIG_ISA64, ELF64_ST_TYPE, ELF32_ST_TYPE)
+
+static Symbol *symtab = NULL;
+static int nr_sym = 0;
+
+static int symbol_cmp(const void *a, const void *b) {
+  vaddr_t x = ((const Symbol *)a)->addr, y = ((const Symbol *)b)->addr;
+  return (x > y) - (x < y);
+}
+
+void init_elf(const char *file) {
+  int i, j;
+  if (file == NULL) return;
+  FILE *fp = fopen(file, "rb");
+  Assert(fp, "Can not open '%s'", file);
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  uint8_t *buf = malloc(size);
+  assert(buf);
+  int ret = fread(buf, size, 1, fp);
+  assert(ret == 1);
+  fclose(fp);
+
+  Elf_Ehdr *eh = (Elf_Ehdr *)buf;
+  Assert(size >= sizeof(*eh) && memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0, "'%s' is not an ELF", file);
+  Assert(eh->e_ident[EI_CLASS] == MUXDEF(CONFIG_ISA64, ELFCLASS64, ELFCLASS32),
+      "'%s' does not match the word size of the guest", file);
+
+  Elf_Shdr *sh = (Elf_Shdr *)(buf + eh->e_shoff);
+  for (i = 0; i < eh->e_shnum; i ++) {
+    if (sh[i].sh_type != SHT_SYMTAB) continue;
+    Elf_Sym *sym = (Elf_Sym *)(buf + sh[i].sh_offset);
+    const char *strtab = (const char *)(buf + sh[sh[i].sh_link].sh_offset);
+    int n = sh[i].sh_size / sizeof(Elf_Sym);
+    symtab = realloc(symtab, (nr_sym + n) * sizeof(Symbol));
+    assert(symtab);
+    for (j = 0; j < n; j ++) {
+      if (ELF_ST_TYPE(sym[j].st_info) != STT_FUNC || sym[j].st_shndx == SHN_UNDEF) continue;
+      symtab[nr_sym ++] = (Symbol) {
+        .addr = sym[j].st_value, .size = sym[j].st_size, .name = strdup(strtab + sym[j].st_name) };
+    }
+  }
+  free(buf);
+
+  qsort(symtab, nr_sym, sizeof(Symbol), symbol_cmp);
+  // keep one of the aliases at the same address, and give the symbols
+  // without a size the space until the next one
+  int n = 0;
+  for (i = 0; i < nr_sym; i ++) {
+    if (n > 0 && symtab[n - 1].addr == symtab[i].addr) {
+      free((char *)symtab[i].name);
+      continue;
+    }
+    symtab[n ++] = symtab[i];
+  }
+  nr_sym = n;
+  for (i = 0; i < nr_sym; i ++) {
+    if (symtab[i].size == 0) symtab[i].size = (i + 1 < nr_sym ? symtab[i + 1].addr - symtab[i].addr : 1);
+  }
+  Log("%d function symbols are loaded from %s", nr_sym, file);
+}
+
+int symbol_nr() { return nr_sym; }
+
+const Symbol *symbol_get(int idx) { return &symtab[idx]; }
+
+int symbol_find(vaddr_t addr) {
+  // the last symbol starting at or before `addr'
+  int lo = 0, hi = nr_sym;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (symtab[mid].addr <= addr) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo == 0) return -1;
+  const Symbol *s = &symtab[lo - 1];
+  return (addr - s->addr < s->size ? lo - 1 : -1);
+}
+#endif
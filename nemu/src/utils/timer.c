@@ -14,6 +14,8 @@
 ***************************************************************************************/
 
 #include <common.h>
+#include <cpu/cpu.h>
+#include <cpu/block.h>
 #include MUXDEF(CONFIG_TIMER_GETTIMEOFDAY, <sys/time.h>, <time.h>)
 
 IFDEF(CONFIG_TIMER_CLOCK_GETTIME,
@@ -21,6 +23,42 @@ IFDEF(CONFIG_TIMER_CLOCK_GETTIME,
 IFDEF(CONFIG_TIMER_CLOCK_GETTIME,
     static_assert(sizeof(clock_t) == 8, "sizeof(clock_t) != 8"));
 
+#ifdef CONFIG_TIMER_TSC
+#include <host-clock.h>
+#endif
+
+#if defined(CONFIG_TIMER_TSC) && defined(HOST_HAS_TSC)
+#define HAS_TSC
+
+/* The TSC is taken only if it is invariant and, in a short measurement
+ * at startup, cheaper than CLOCK_MONOTONIC. It is not on some virtual
+ * machines, which trap rdtsc. Otherwise, the monotonic clock is used.
+ */
+#define TSC_CALIBRATE_NS 10000000
+#define TSC_MEASURE_CALLS 10000
+
+static bool tsc_ok = false;
+static TSCClock tsc;
+
+static inline uint64_t tsc_now() { return tsc_us(&tsc); }
+
+static void init_tsc() {
+  uint64_t mhz = tsc_calibrate(&tsc, TSC_CALIBRATE_NS);
+  if (mhz == 0) {
+    Log("TSC is not invariant, take the host time from CLOCK_MONOTONIC");
+    return;
+  }
+  // warm up, then measure
+  host_clock_cost(tsc_now, TSC_MEASURE_CALLS);
+  host_clock_cost(host_monotonic_us, TSC_MEASURE_CALLS);
+  double tsc_ns = host_clock_cost(tsc_now, TSC_MEASURE_CALLS);
+  double monotonic_ns = host_clock_cost(host_monotonic_us, TSC_MEASURE_CALLS);
+  tsc_ok = (tsc_ns < monotonic_ns);
+  Log("TSC runs at %" PRIu64 " MHz, %.1f ns per read against %.1f ns of CLOCK_MONOTONIC, "
+      "take the host time from %s", mhz, tsc_ns, monotonic_ns, tsc_ok ? "TSC" : "CLOCK_MONOTONIC");
+}
+#endif
+
 static uint64_t boot_time = 0;
 
 static uint64_t get_time_internal() {
@@ -30,6 +68,8 @@ static uint64_t get_time_internal() {
   struct timeval now;
   gettimeofday(&now, NULL);
   uint64_t us = now.tv_sec * 1000000 + now.tv_usec;
+#elif defined(CONFIG_TIMER_TSC)
+  uint64_t us = host_monotonic_us();
 #else
   struct timespec now;
   clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
@@ -39,11 +79,38 @@ static uint64_t get_time_internal() {
 }
 
 uint64_t get_time() {
-  if (boot_time == 0) boot_time = get_time_internal();
-  uint64_t now = get_time_internal();
-  return now - boot_time;
+#ifdef HAS_TSC
+  if (likely(tsc_ok)) return tsc_now();
+#endif
+  return get_time_internal() - boot_time;
+}
+
+void init_time() {
+#ifdef HAS_TSC
+  init_tsc();
+#endif
+  boot_time = get_time_internal();
 }
 
+/* Virtual time makes runs reproducible, since the guest time no longer
+ * depends on the speed of the host. Waits of an idle guest are skipped
+ * in either time.
+ */
+static bool virtual_time = MUXDEF(CONFIG_VIRTUAL_TIME, true, false);
+static uint64_t skipped = 0;
+extern HART_LOCAL uint64_t g_nr_guest_inst;
+
+uint64_t get_guest_time() {
+  if (!virtual_time) return get_time() + skipped;
+  uint64_t nr = MUXDEF(CONFIG_SMP, smp_nr_guest_inst(),
+      g_nr_guest_inst + MUXDEF(CONFIG_ENGINE_BLOCK, block_nr_inst(), 0));
+  return nr / CONFIG_VIRTUAL_TIME_MIPS + skipped;
+}
+
+void skip_guest_time(uint64_t us) { skipped += us; }
+void set_virtual_time(bool on) { virtual_time = on; }
+bool is_virtual_time() { return virtual_time; }
+
 void init_rand() {
   srand(get_time_internal());
 }
@@ -0,0 +1,69 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Measure the cost of the host clocks that get_time() of
+ * src/utils/timer.c can be built on, in nanoseconds per call.
+ *
+ * Usage: make run
+ */
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <host-clock.h>
+
+#define NR_CALL 10000000
+
+static uint64_t us_gettimeofday() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static uint64_t us_monotonic_coarse() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+  return now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+#ifdef HOST_HAS_TSC
+static TSCClock tsc;
+static uint64_t us_tsc() { return tsc_us(&tsc); }
+#endif
+
+static void report(const char *name, uint64_t (*clock)()) {
+  host_clock_cost(clock, NR_CALL); // warm up
+  printf("%-22s  %8.2f\n", name, host_clock_cost(clock, NR_CALL));
+}
+
+int main() {
+  printf("clock                   ns/call\n");
+  report("gettimeofday", us_gettimeofday);
+  report("CLOCK_MONOTONIC", host_monotonic_us);
+  report("CLOCK_MONOTONIC_COARSE", us_monotonic_coarse);
+#ifdef HOST_HAS_TSC
+  if (tsc_calibrate(&tsc, 10000000) != 0) {
+    report("rdtsc", us_tsc);
+    // check the calibration over one second
+    uint64_t us0 = us_tsc(), ns0 = host_monotonic_ns();
+    while (host_monotonic_ns() - ns0 < 1000000000ull);
+    uint64_t us = us_tsc() - us0, ns = host_monotonic_ns() - ns0;
+    printf("rdtsc drift against CLOCK_MONOTONIC: %+.1f ppm\n",
+        ((double)us * 1000 - (double)ns) / ns * 1e6);
+  } else {
+    printf("rdtsc: TSC is not invariant\n");
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,123 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Measure the operand extraction of riscv32 for each instruction type,
+ * comparing a switch on the type at runtime with operand_<type>() in
+ * local-include/operand.h, which is specialized at compile time.
+ *
+ * Usage: make run
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <operand.h>
+
+#define NR_INST 4096
+#define NR_REPEAT 20000
+
+enum { TYPE_R, TYPE_I, TYPE_S, TYPE_B, TYPE_U, TYPE_J, NR_TYPE };
+static const char *type_name[] = { "R", "I", "S", "B", "U", "J" };
+
+typedef struct {
+  uint32_t inst;
+  uint8_t rd, rs1, rs2;
+  uint32_t imm;
+} Slot;
+
+static Slot slot[NR_INST];
+static volatile int runtime_type; // unknown to the compiler
+
+// the former decode_operand() of inst.c
+static __attribute__((noinline)) void operand_switch(Slot *s, int type) {
+  uint32_t i = s->inst;
+  int rs1 = BITS(i, 19, 15);
+  int rs2 = BITS(i, 24, 20);
+  s->rd  = BITS(i, 11, 7);
+  s->rs1 = 0;
+  s->rs2 = 0;
+  s->imm = 0;
+  switch (type) {
+    case TYPE_R: s->rs1 = rs1; s->rs2 = rs2;                     break;
+    case TYPE_I: s->rs1 = rs1;                   s->imm = immI(i); break;
+    case TYPE_S: s->rs1 = rs1; s->rs2 = rs2;     s->imm = immS(i); break;
+    case TYPE_B: s->rs1 = rs1; s->rs2 = rs2;     s->imm = immB(i); break;
+    case TYPE_U:                                 s->imm = immU(i); break;
+    case TYPE_J:                                 s->imm = immJ(i); break;
+  }
+}
+
+// instructions are decoded one by one in NEMU, so keep the compiler
+// from vectorizing the loops
+#define barrier() asm volatile("" : : : "memory")
+
+static inline void store(Slot *s, Operand op) {
+  s->rd = op.rd; s->rs1 = op.rs1; s->rs2 = op.rs2; s->imm = op.imm;
+}
+
+#define def_specialized(t) \
+  static __attribute__((noinline)) void concat(run_, t)() { \
+    int k; \
+    for (k = 0; k < NR_INST; k ++) { store(&slot[k], concat(operand_, t)(slot[k].inst)); barrier(); } \
+  }
+def_specialized(R) def_specialized(I) def_specialized(S)
+def_specialized(B) def_specialized(U) def_specialized(J)
+static void (*run_specialized[])() = { run_R, run_I, run_S, run_B, run_U, run_J };
+
+static void run_switch() {
+  int type = runtime_type;
+  int k;
+  for (k = 0; k < NR_INST; k ++) { operand_switch(&slot[k], type); barrier(); }
+}
+
+static uint64_t checksum() {
+  uint64_t sum = 0;
+  int k;
+  for (k = 0; k < NR_INST; k ++) {
+    sum = sum * 31 + slot[k].rd + (slot[k].rs1 << 5) + (slot[k].rs2 << 10) + slot[k].imm;
+  }
+  return sum;
+}
+
+static double measure(void (*run)()) {
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  int r;
+  for (r = 0; r < NR_REPEAT; r ++) run();
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+  return ns / ((double)NR_REPEAT * NR_INST);
+}
+
+int main() {
+  int k, t;
+  srand(1);
+  for (k = 0; k < NR_INST; k ++) slot[k].inst = ((uint32_t)rand() << 16) ^ rand();
+
+  measure(run_switch); // warm up
+  printf("type  switch (ns/inst)  specialized (ns/inst)  speedup\n");
+  for (t = 0; t < NR_TYPE; t ++) {
+    runtime_type = t;
+    double a = measure(run_switch);
+    uint64_t sum = checksum();
+    double b = measure(run_specialized[t]);
+    if (checksum() != sum) {
+      printf("type %s: results mismatch\n", type_name[t]);
+      return 1;
+    }
+    printf("%-4s  %16.3f  %21.3f  %6.2fx\n", type_name[t], a, b, a / b);
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Generate a riscv32 image where each instruction pair fused by
+ * isa_threaded_fuse() ends a block, once at BLOCK_MAX_INSTR and once
+ * at the end of a page, and check the result of the pair after it.
+ * The image hits GOOD TRAP if all checks pass.
+ *
+ * Usage: make run [NEMU=path/to/nemu]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+
+// the same as include/cpu/block.h
+#define BLOCK_MAX_INSTR 64
+#define PAGE_SIZE 4096
+#define MAX_INST (PAGE_SIZE * 16 / 4)
+
+enum { zero = 0, ra = 1, t0 = 5, t1 = 6, s0 = 8, a0 = 10, a1 = 11 };
+
+static uint32_t img[MAX_INST];
+static int nr_inst = 0;
+
+static void emit(uint32_t inst) {
+  assert(nr_inst < MAX_INST);
+  img[nr_inst ++] = inst;
+}
+
+static int pc() { return nr_inst * 4; }
+
+static uint32_t r_type(int f7, int rs2, int rs1, int f3, int rd, int op) {
+  return (f7 << 25) | (rs2 << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) | op;
+}
+
+static uint32_t i_type(int imm, int rs1, int f3, int rd, int op) {
+  return ((uint32_t)imm << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) | op;
+}
+
+static uint32_t b_type(int off, int rs2, int rs1, int f3) {
+  uint32_t imm = off;
+  return (((imm >> 12) & 1) << 31) | (((imm >> 5) & 0x3f) << 25) | (rs2 << 20) | (rs1 << 15) |
+    (f3 << 12) | (((imm >> 1) & 0xf) << 8) | (((imm >> 11) & 1) << 7) | 0x63;
+}
+
+static uint32_t j_type(int off, int rd) {
+  uint32_t imm = off;
+  return (((imm >> 20) & 1) << 31) | (((imm >> 1) & 0x3ff) << 21) | (((imm >> 11) & 1) << 20) |
+    (((imm >> 12) & 0xff) << 12) | (rd << 7) | 0x6f;
+}
+
+#define LUI(rd, imm20)      emit(((uint32_t)(imm20) << 12) | ((rd) << 7) | 0x37)
+#define AUIPC(rd, imm20)    emit(((uint32_t)(imm20) << 12) | ((rd) << 7) | 0x17)
+#define ADDI(rd, rs1, imm)  emit(i_type(imm, rs1, 0, rd, 0x13))
+#define SLTI(rd, rs1, imm)  emit(i_type(imm, rs1, 2, rd, 0x13))
+#define SLTIU(rd, rs1, imm) emit(i_type(imm, rs1, 3, rd, 0x13))
+#define SLLI(rd, rs1, sh)   emit(i_type(sh, rs1, 1, rd, 0x13))
+#define SRLI(rd, rs1, sh)   emit(i_type(sh, rs1, 5, rd, 0x13))
+#define SLT(rd, rs1, rs2)   emit(r_type(0, rs2, rs1, 2, rd, 0x33))
+#define SLTU(rd, rs1, rs2)  emit(r_type(0, rs2, rs1, 3, rd, 0x33))
+#define JALR(rd, rs1, imm)  emit(i_type(imm, rs1, 0, rd, 0x67))
+#define BEQ(rs1, rs2, off)  emit(b_type(off, rs2, rs1, 0))
+#define BNE(rs1, rs2, off)  emit(b_type(off, rs2, rs1, 1))
+#define JAL(rd, off)        emit(j_type(off, rd))
+#define NOP()               ADDI(zero, zero, 0)
+#define EBREAK()            emit(0x00100073)
+
+// nemu_trap with a0 = 1 unless the branch before it is taken
+static void fail() {
+  ADDI(a0, zero, 1);
+  EBREAK();
+}
+
+// start a new block, and pad it so that the pair to be emitted ends it
+static void block_end_at_limit() {
+  int i;
+  JAL(zero, 4);
+  for (i = 0; i < BLOCK_MAX_INSTR - 2; i ++) NOP();
+}
+
+static void block_end_at_page() {
+  int i;
+  while ((pc() + 8 + 4 * 16) % PAGE_SIZE != 0) NOP();
+  JAL(zero, 4);
+  for (i = 0; i < 15; i ++) NOP();
+}
+
+static void check_a0_equals_t0() {
+  BEQ(a0, t0, 12);
+  fail();
+}
+
+static void test_pairs(void (*pad)()) {
+  // lui_addi: a0 = 0x12345678
+  pad();
+  LUI(a0, 0x12345); ADDI(a0, a0, 0x678);
+  LUI(t0, 0x12345); ADDI(t0, t0, 0x678);
+  check_a0_equals_t0();
+
+  // auipc_addi: a0 = pc of auipc + 4
+  pad();
+  AUIPC(a0, 0); ADDI(a0, a0, 4);
+  AUIPC(t0, 0); ADDI(t0, t0, -4);
+  check_a0_equals_t0();
+
+  // slli_srli: a0 = 0xffff
+  pad();
+  SLLI(a0, a1, 16); SRLI(a0, a0, 16);
+  LUI(t0, 0x10); ADDI(t0, t0, -1);
+  check_a0_equals_t0();
+
+  // auipc_jalr: jump over the fail, and ra = pc of jalr + 4
+  pad();
+  AUIPC(ra, 0); JALR(ra, ra, 16);
+  fail();
+  AUIPC(t0, 0); ADDI(t0, t0, -8);
+  BEQ(ra, t0, 12);
+  fail();
+
+  // slt_bxx and the like with a1 = -1, branching over the fail
+  pad();
+  SLT(t1, a1, zero); BNE(t1, zero, 12);
+  fail();
+  pad();
+  SLTU(t1, a1, zero); BEQ(t1, zero, 12);
+  fail();
+  pad();
+  SLTI(t1, a1, 0); BNE(t1, zero, 12);
+  fail();
+  pad();
+  SLTIU(t1, a1, 1); BEQ(t1, zero, 12);
+  fail();
+}
+
+int main(int argc, char *argv[]) {
+  FILE *fp = (argc > 1 ? fopen(argv[1], "wb") : stdout);
+  assert(fp);
+
+  // blocks are built when the code is run again, and chained after that
+  ADDI(s0, zero, 3);
+  ADDI(a1, zero, -1);
+  int loop = pc();
+  test_pairs(block_end_at_limit);
+  test_pairs(block_end_at_page);
+  ADDI(s0, s0, -1);
+  BEQ(s0, zero, 8);
+  JAL(zero, loop - pc());
+  ADDI(a0, zero, 0);
+  EBREAK();
+
+  int ret = fwrite(img, 4, nr_inst, fp);
+  assert(ret == nr_inst);
+  fclose(fp);
+  return 0;
+}
@@ -0,0 +1,379 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Generate a switch tree from the instruction patterns of an ISA.
+ *
+ * Usage: gen-decode [-f HI:LO]... FILE
+ *
+ * Every line of FILE in the form of
+ *   f("pattern", name, type, ...)
+ * is an item of the instruction list. Items are matched in order, so an
+ * instruction is decoded as the first item whose pattern it matches.
+ * The tree switches on the fields given by `-f' in order, and the
+ * remaining bits of each candidate are tested linearly at the leaves.
+ *
+ * Before emitting, the tree is checked against linear matching on every
+ * class of instructions which can be told apart by the patterns. See
+ * verify() for details.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <assert.h>
+
+#define NR_PAT_MAX 1024
+#define NR_FIELD_MAX 8
+#define MAX_RESIDUAL_BITS 20
+
+typedef struct {
+  char name[64];
+  char type[16];
+  uint64_t key, mask;
+} Pattern;
+
+typedef struct {
+  int hi, lo;
+} Field;
+
+typedef struct Node {
+  int field;           // index of the field to switch, or -1 for leaves
+  struct Node **child; // indexed by the value of the field
+  int nr_cand;         // candidates of leaves, in the order of the list
+  int *cand;
+  uint64_t covered;    // bits which have been switched on the path
+} Node;
+
+static Pattern pat[NR_PAT_MAX];
+static int nr_pat = 0;
+static Field field[NR_FIELD_MAX];
+static int nr_field = 0;
+
+#define BITMASK(bits) ((1ull << (bits)) - 1)
+
+static uint64_t field_mask(int k) {
+  return BITMASK(field[k].hi - field[k].lo + 1) << field[k].lo;
+}
+
+static void parse_pattern(const char *str, int len, Pattern *p, int lineno) {
+  uint64_t key = 0, mask = 0;
+  int i;
+  for (i = 0; i < len; i ++) {
+    char c = str[i];
+    if (c == ' ') continue;
+    if (c != '0' && c != '1' && c != '?') {
+      fprintf(stderr, "line %d: invalid character '%c' in pattern string\n", lineno, c);
+      exit(1);
+    }
+    key  = (key  << 1) | (c == '1');
+    mask = (mask << 1) | (c != '?');
+  }
+  p->key = key;
+  p->mask = mask;
+}
+
+static char* parse_ident(char *s, char *buf, int size) {
+  while (isspace(*s)) s ++;
+  int n = 0;
+  while (isalnum(*s) || *s == '_') {
+    if (n < size - 1) buf[n ++] = *s;
+    s ++;
+  }
+  buf[n] = '\0';
+  while (isspace(*s)) s ++;
+  return s;
+}
+
+static void load_patterns(const char *file) {
+  FILE *fp = fopen(file, "r");
+  if (fp == NULL) { perror(file); exit(1); }
+
+  char line[1024];
+  int lineno = 0;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    lineno ++;
+    char *s = line;
+    while (isspace(*s)) s ++;
+    if (strncmp(s, "f(\"", 3) != 0) continue;
+
+    s += 3;
+    char *end = strchr(s, '"');
+    if (end == NULL) { fprintf(stderr, "line %d: unterminated pattern\n", lineno); exit(1); }
+    assert(nr_pat < NR_PAT_MAX);
+    Pattern *p = &pat[nr_pat];
+    parse_pattern(s, end - s, p, lineno);
+
+    s = end + 1;
+    while (isspace(*s)) s ++;
+    if (*s == ',') s = parse_ident(s + 1, p->name, sizeof(p->name));
+    if (*s == ',') s = parse_ident(s + 1, p->type, sizeof(p->type));
+    if (p->name[0] == '\0' || p->type[0] == '\0' || (*s != ',' && *s != ')')) {
+      fprintf(stderr, "line %d: expect f(\"pattern\", name, type, ...)\n", lineno);
+      exit(1);
+    }
+    nr_pat ++;
+  }
+  fclose(fp);
+
+  if (nr_pat == 0) { fprintf(stderr, "%s: no pattern found\n", file); exit(1); }
+}
+
+// whether pattern `p' can match an instruction with `val' in field `k'
+static int compatible(Pattern *p, int k, uint64_t val) {
+  return (((val << field[k].lo) ^ p->key) & p->mask & field_mask(k)) == 0;
+}
+
+static Node* new_leaf(int *cand, int nr_cand, uint64_t covered) {
+  Node *n = calloc(1, sizeof(Node));
+  n->field = -1;
+  n->cand = malloc(sizeof(int) * (nr_cand > 0 ? nr_cand : 1));
+  memcpy(n->cand, cand, sizeof(int) * nr_cand);
+  n->nr_cand = nr_cand;
+  n->covered = covered;
+  return n;
+}
+
+static Node* build(int *cand, int nr_cand, int k, uint64_t covered) {
+  // the first candidate always matches if all of its bits have been switched
+  if (nr_cand == 0 || (pat[cand[0]].mask & ~covered) == 0) {
+    return new_leaf(cand, nr_cand > 0 ? 1 : 0, covered);
+  }
+
+  // skip fields which no candidate cares about
+  for (; k < nr_field; k ++) {
+    int i;
+    for (i = 0; i < nr_cand; i ++) {
+      if (pat[cand[i]].mask & field_mask(k)) break;
+    }
+    if (i < nr_cand) break;
+  }
+  if (k == nr_field) return new_leaf(cand, nr_cand, covered);
+
+  Node *n = calloc(1, sizeof(Node));
+  int nr_val = 1 << (field[k].hi - field[k].lo + 1);
+  n->field = k;
+  n->covered = covered;
+  n->child = malloc(sizeof(Node *) * nr_val);
+  int *sub = malloc(sizeof(int) * nr_cand);
+  for (int v = 0; v < nr_val; v ++) {
+    int nr_sub = 0;
+    for (int i = 0; i < nr_cand; i ++) {
+      if (compatible(&pat[cand[i]], k, v)) sub[nr_sub ++] = cand[i];
+    }
+    n->child[v] = build(sub, nr_sub, k + 1, covered | field_mask(k));
+  }
+  free(sub);
+  return n;
+}
+
+// --- verification ---
+
+static int match_linear(uint64_t inst) {
+  for (int i = 0; i < nr_pat; i ++) {
+    if ((inst & pat[i].mask) == pat[i].key) return i;
+  }
+  return -1;
+}
+
+static int match_tree(Node *n, uint64_t inst) {
+  while (n->field != -1) {
+    Field *f = &field[n->field];
+    n = n->child[(inst >> f->lo) & BITMASK(f->hi - f->lo + 1)];
+  }
+  for (int i = 0; i < n->nr_cand; i ++) {
+    Pattern *p = &pat[n->cand[i]];
+    uint64_t resid = p->mask & ~n->covered;
+    if ((inst & resid) == (p->key & resid)) return n->cand[i];
+  }
+  return -1;
+}
+
+/* For fixed values of all fields, the result of linear matching only
+ * depends on the bits outside the fields which are tested by the
+ * patterns compatible with these values. Enumerating every assignment
+ * of these bits for every assignment of the fields therefore covers all
+ * instructions. The remaining bits are set to all 0s and all 1s to make
+ * sure that the tree does not depend on them either.
+ */
+static uint64_t verify(Node *root) {
+  uint64_t fmask = 0;
+  int nr_fbits = 0;
+  for (int k = 0; k < nr_field; k ++) {
+    fmask |= field_mask(k);
+    nr_fbits += field[k].hi - field[k].lo + 1;
+  }
+  assert(nr_fbits <= 24);
+
+  uint64_t nr_checked = 0;
+  for (uint64_t fv = 0; fv < (1ull << nr_fbits); fv ++) {
+    // scatter `fv' into the fields
+    uint64_t base = 0, t = fv;
+    for (int k = nr_field - 1; k >= 0; k --) {
+      int w = field[k].hi - field[k].lo + 1;
+      base |= (t & BITMASK(w)) << field[k].lo;
+      t >>= w;
+    }
+
+    uint64_t resid = 0;
+    for (int i = 0; i < nr_pat; i ++) {
+      if (((base ^ pat[i].key) & pat[i].mask & fmask) == 0) resid |= pat[i].mask & ~fmask;
+    }
+    if (__builtin_popcountll(resid) > MAX_RESIDUAL_BITS) {
+      fprintf(stderr, "too many residual bits (0x%llx) to verify, add more fields\n",
+          (unsigned long long)resid);
+      exit(1);
+    }
+
+    for (int fill = 0; fill < 2; fill ++) {
+      uint64_t rest = (fill ? BITMASK(32) : 0) & ~fmask & ~resid;
+      uint64_t sub = resid;
+      while (1) {
+        uint64_t inst = base | rest | sub;
+        int l = match_linear(inst), r = match_tree(root, inst);
+        if (l != r) {
+          fprintf(stderr, "mismatch at inst = 0x%08llx: linear = %s, tree = %s\n",
+              (unsigned long long)inst, l == -1 ? "(none)" : pat[l].name,
+              r == -1 ? "(none)" : pat[r].name);
+          exit(1);
+        }
+        nr_checked ++;
+        if (sub == 0) break;
+        sub = (sub - 1) & resid;
+      }
+    }
+  }
+  return nr_checked;
+}
+
+// --- code generation ---
+
+typedef struct {
+  char *buf;
+  size_t len, size;
+} Str;
+
+static void append(Str *s, const char *str, size_t n) {
+  if (s->len + n + 1 > s->size) {
+    s->size = (s->len + n + 1) * 2;
+    s->buf = realloc(s->buf, s->size);
+  }
+  memcpy(s->buf + s->len, str, n);
+  s->len += n;
+  s->buf[s->len] = '\0';
+}
+
+__attribute__((format(printf, 3, 4)))
+static void emit(Str *s, int indent, const char *fmt, ...) {
+  char line[512];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = snprintf(line, sizeof(line), "%*s", indent * 2, "");
+  n += vsnprintf(line + n, sizeof(line) - n, fmt, ap);
+  va_end(ap);
+  assert(n < (int)sizeof(line) - 1);
+  line[n ++] = '\n';
+  append(s, line, n);
+}
+
+static void gen(Node *n, Str *s, int indent) {
+  if (n->field == -1) {
+    for (int i = 0; i < n->nr_cand; i ++) {
+      Pattern *p = &pat[n->cand[i]];
+      uint64_t resid = p->mask & ~n->covered;
+      const char *prefix = (i == 0 ? "" : "else ");
+      if (resid == 0) {
+        emit(s, indent, "%sINSTPAT_MATCH(s, %s, %s)", prefix, p->name, p->type);
+        break;
+      }
+      emit(s, indent, "%sif ((INSTPAT_INST(s) & 0x%llx) == 0x%llx) INSTPAT_MATCH(s, %s, %s)", prefix,
+          (unsigned long long)resid, (unsigned long long)(p->key & resid), p->name, p->type);
+    }
+    return;
+  }
+
+  Field *f = &field[n->field];
+  int nr_val = 1 << (f->hi - f->lo + 1);
+  Str *code = calloc(nr_val, sizeof(Str));
+  for (int v = 0; v < nr_val; v ++) gen(n->child[v], &code[v], indent + 2);
+
+  // group values with the same code, and use the largest group as default
+  int *group = malloc(sizeof(int) * nr_val);
+  int dft = -1, dft_size = 0;
+  for (int v = 0; v < nr_val; v ++) {
+    group[v] = v;
+    for (int u = 0; u < v; u ++) {
+      if (strcmp(code[u].buf, code[v].buf) == 0) { group[v] = group[u]; break; }
+    }
+    int size = 0;
+    for (int u = 0; u <= v; u ++) size += (group[u] == group[v]);
+    if (size > dft_size) { dft = group[v]; dft_size = size; }
+  }
+
+  emit(s, indent, "switch (BITS(INSTPAT_INST(s), %d, %d)) {", f->hi, f->lo);
+  for (int v = 0; v < nr_val; v ++) {
+    if (group[v] != v || v == dft) continue;
+    for (int u = v; u < nr_val; u ++) {
+      if (group[u] == v) emit(s, indent + 1, "case 0x%x:", u);
+    }
+    append(s, code[v].buf, code[v].len);
+    emit(s, indent + 2, "break;");
+  }
+  emit(s, indent + 1, "default:");
+  append(s, code[dft].buf, code[dft].len);
+  emit(s, indent + 2, "break;");
+  emit(s, indent, "}");
+
+  for (int v = 0; v < nr_val; v ++) free(code[v].buf);
+  free(code);
+  free(group);
+}
+
+int main(int argc, char *argv[]) {
+  const char *file = NULL;
+  for (int i = 1; i < argc; i ++) {
+    if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      assert(nr_field < NR_FIELD_MAX);
+      Field *f = &field[nr_field ++];
+      if (sscanf(argv[++ i], "%d:%d", &f->hi, &f->lo) != 2 || f->hi < f->lo || f->hi >= 32) {
+        fprintf(stderr, "invalid field '%s'\n", argv[i]);
+        return 1;
+      }
+    } else {
+      file = argv[i];
+    }
+  }
+  if (file == NULL) {
+    fprintf(stderr, "Usage: %s [-f HI:LO]... FILE\n", argv[0]);
+    return 1;
+  }
+
+  load_patterns(file);
+
+  int *cand = malloc(sizeof(int) * nr_pat);
+  for (int i = 0; i < nr_pat; i ++) cand[i] = i;
+  Node *root = build(cand, nr_pat, 0, 0);
+  uint64_t nr_checked = verify(root);
+
+  Str code = {};
+  gen(root, &code, 1);
+  printf("// Generated by tools/gen-decode from %s, DO NOT EDIT.\n", file);
+  printf("// %d patterns, checked against linear matching with %llu instructions.\n",
+      nr_pat, (unsigned long long)nr_checked);
+  printf("{\n%s}\n", code.buf);
+  return 0;
+}
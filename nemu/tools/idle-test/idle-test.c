@@ -0,0 +1,149 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Generate a riscv32 image which polls the RTC in the loops below, and
+ * checks with RTC_IDLE that
+ *   - a loop waiting for a known deadline skips to it at once;
+ *   - a loop waiting for an unknown deadline takes few polls;
+ *   - a loop doing some work between the reads is not taken as polling,
+ *     so that its time is not skipped.
+ * The image hits GOOD TRAP if all checks pass.
+ *
+ * Usage: make run [NEMU=path/to/nemu]
+ */
+
+#include <common.h>
+#include <stdio.h>
+
+#define WAIT_US 3000000
+#define MAX_INST 256
+
+enum { zero = 0, t0 = 5, t1 = 6, t2 = 7, s1 = 9, a0 = 10, a5 = 15,
+  s2 = 18, s3 = 19, s4 = 20, s6 = 22, s7 = 23, t3 = 28, t4 = 29, t5 = 30 };
+enum { CSR_INSTRET = 0xc02 };
+
+static uint32_t img[MAX_INST];
+static int nr_inst = 0;
+
+static void emit(uint32_t inst) {
+  assert(nr_inst < MAX_INST);
+  img[nr_inst ++] = inst;
+}
+
+static int pc() { return nr_inst * 4; }
+
+static uint32_t r_type(int f7, int rs2, int rs1, int f3, int rd, int op) {
+  return (f7 << 25) | (rs2 << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) | op;
+}
+
+static uint32_t i_type(int imm, int rs1, int f3, int rd, int op) {
+  return ((uint32_t)imm << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) | op;
+}
+
+static uint32_t b_type(int off, int rs2, int rs1, int f3) {
+  uint32_t imm = off;
+  return (((imm >> 12) & 1) << 31) | (((imm >> 5) & 0x3f) << 25) | (rs2 << 20) | (rs1 << 15) |
+    (f3 << 12) | (((imm >> 1) & 0xf) << 8) | (((imm >> 11) & 1) << 7) | 0x63;
+}
+
+#define LUI(rd, imm20)      emit(((uint32_t)(imm20) << 12) | ((rd) << 7) | 0x37)
+#define ADDI(rd, rs1, imm)  emit(i_type(imm, rs1, 0, rd, 0x13))
+#define LW(rd, rs1, imm)    emit(i_type(imm, rs1, 2, rd, 0x03))
+#define ADD(rd, rs1, rs2)   emit(r_type(0, rs2, rs1, 0, rd, 0x33))
+#define SUB(rd, rs1, rs2)   emit(r_type(0x20, rs2, rs1, 0, rd, 0x33))
+#define MUL(rd, rs1, rs2)   emit(r_type(1, rs2, rs1, 0, rd, 0x33))
+#define CSRR(rd, csr)       emit(i_type(csr, zero, 2, rd, 0x73))
+#define BNE(rs1, rs2, off)  emit(b_type(off, rs2, rs1, 1))
+#define BLTU(rs1, rs2, off) emit(b_type(off, rs2, rs1, 6))
+#define EBREAK()            emit(0x00100073)
+
+static void li(int rd, uint32_t val) {
+  LUI(rd, (val + 0x800) >> 12);
+  ADDI(rd, rd, (int32_t)(val << 20) >> 20);
+}
+
+// read the RTC as the AM timer does, the low word into `rd'
+static void read_rtc(int rd) {
+  LW(t0, a5, 4);
+  LW(rd, a5, 0);
+}
+
+// nemu_trap with a0 = 1 unless `rs1' < `rs2'
+static void check_ltu(int rs1, int rs2) {
+  BLTU(rs1, rs2, 12);
+  ADDI(a0, zero, 1);
+  EBREAK();
+}
+
+int main(int argc, char *argv[]) {
+  FILE *fp = (argc > 1 ? fopen(argv[1], "wb") : stdout);
+  assert(fp);
+  int loop, inner;
+
+  li(a5, CONFIG_RTC_MMIO);
+
+  // wait until the low word reaches a deadline in s1
+  CSRR(s6, CSR_INSTRET);
+  read_rtc(t1);
+  li(s1, WAIT_US);
+  ADD(s1, t1, s1);
+  loop = pc();
+  read_rtc(t1);
+  BLTU(t1, s1, loop - pc());
+  CSRR(s7, CSR_INSTRET);
+  SUB(s7, s7, s6);
+  li(t2, 100);
+  check_ltu(s7, t2);
+
+  // wait until the time since the start in s2 reaches s3
+  CSRR(s6, CSR_INSTRET);
+  read_rtc(s2);
+  li(s3, WAIT_US);
+  loop = pc();
+  read_rtc(t1);
+  SUB(t2, t1, s2);
+  BLTU(t2, s3, loop - pc());
+  CSRR(s7, CSR_INSTRET);
+  SUB(s7, s7, s6);
+  li(t2, 100000);
+  check_ltu(s7, t2);
+
+  // read the RTC, then work for 40 iterations, 1000 times
+  read_rtc(s2);
+  li(s4, 1000);
+  loop = pc();
+  read_rtc(t1);
+  ADDI(t3, zero, 40);
+  inner = pc();
+  MUL(t4, t4, t5);
+  ADD(t5, t5, t4);
+  ADDI(t3, t3, -1);
+  BNE(t3, zero, inner - pc());
+  ADDI(s4, s4, -1);
+  BNE(s4, zero, loop - pc());
+  read_rtc(t1);
+  SUB(t2, t1, s2);
+  // the instructions in the loop, with a margin of 10 us
+  li(t3, 1000 * (2 + 1 + 40 * 4 + 2) / CONFIG_VIRTUAL_TIME_MIPS + 10);
+  check_ltu(t2, t3);
+
+  ADDI(a0, zero, 0);
+  EBREAK();
+
+  int ret = fwrite(img, 4, nr_inst, fp);
+  assert(ret == nr_inst);
+  fclose(fp);
+  return 0;
+}
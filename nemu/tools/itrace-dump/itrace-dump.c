@@ -0,0 +1,114 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Disassemble the binary instruction trace written by NEMU with
+ * CONFIG_ITRACE_BINARY into the text of the instruction trace. It is
+ * built with the configuration of the NEMU tree, so that the disassembler
+ * knows the same extensions.
+ *
+ * Usage: make ARGS=FILE run
+ */
+
+#include <common.h>
+#include <itrace-def.h>
+#include <stdio.h>
+#ifdef CONFIG_ISA_riscv
+#include <rvc.h>
+#endif
+
+#define NR_CHUNK 4096
+
+void init_disasm(const char *triple);
+void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
+
+static uint64_t load_le(const uint8_t *p, int len) {
+  uint64_t v = 0;
+  for (int i = len - 1; i >= 0; i --) v = (v << 8) | p[i];
+  return v;
+}
+
+#ifdef CONFIG_ISA_riscv
+static const char *regs[] = {
+  "$0", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+  "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+  "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+  "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+// Return the integer register written by `inst', or 0 if there is none.
+static int written_reg(uint32_t inst) {
+  if (RVC_IS_COMPRESSED(inst)) inst = MUXDEF(CONFIG_RVC, rvc_expand(inst), RVC_ILLEGAL);
+  int rd = BITS(inst, 11, 7);
+  int funct3 = BITS(inst, 14, 12);
+  switch (BITS(inst, 6, 0)) {
+    case 0x03: case 0x13: case 0x17: case 0x1b: case 0x2f:
+    case 0x33: case 0x37: case 0x3b: case 0x67: case 0x6f: return rd;
+    case 0x73: return funct3 != 0 ? rd : 0;  // Zicsr
+    case 0x57:  // vset{i}vl{i}, and vmv.x.s/vcpop.m/vfirst.m
+      return (funct3 == 7 || (funct3 == 2 && BITS(inst, 31, 26) == 0x10)) ? rd : 0;
+    default: return 0;
+  }
+}
+#endif
+
+static int inst_len(uint32_t inst) {
+  return MUXDEF(CONFIG_ISA_riscv, RVC_IS_COMPRESSED(inst) ? 2 : 4, 4);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s FILE\n", argv[0]);
+    return 1;
+  }
+  FILE *fp = fopen(argv[1], "rb");
+  if (fp == NULL) { perror(argv[1]); return 1; }
+
+  ItraceHeader h;
+  if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, ITRACE_MAGIC, sizeof(h.magic)) != 0) {
+    fprintf(stderr, "%s is not a binary instruction trace\n", argv[1]);
+    return 1;
+  }
+  assert(h.rec_size == h.pc_size + 4 + h.rd_size);
+  init_disasm(h.triple);
+
+  static uint8_t buf[NR_CHUNK * 64];
+  assert(h.rec_size <= 64);
+  size_t nr;
+  while ((nr = fread(buf, h.rec_size, NR_CHUNK, fp)) > 0) {
+    for (uint8_t *r = buf; r < buf + nr * h.rec_size; r += h.rec_size) {
+      uint64_t pc = load_le(r, h.pc_size);
+      uint32_t inst = load_le(r + h.pc_size, 4);
+      int ilen = inst_len(inst);
+
+      char line[128];
+      char *p = line + sprintf(line, "0x%0*" PRIx64 ":", h.pc_size * 2, pc);
+      for (int i = ilen - 1; i >= 0; i --) p += sprintf(p, " %02x", (inst >> (i * 8)) & 0xff);
+      p += sprintf(p, "%*s", (4 - ilen) * 3 + 1, "");
+      disassemble(p, line + sizeof(line) - p, pc, (uint8_t *)&inst, ilen);
+
+#ifdef CONFIG_ISA_riscv
+      int rd = (h.rd_size > 0 ? written_reg(inst) : 0);
+      if (rd != 0) {
+        printf("%s\t# %s = 0x%0*" PRIx64 "\n", line, regs[rd], h.rd_size * 2,
+            load_le(r + h.pc_size + 4, h.rd_size));
+        continue;
+      }
+#endif
+      printf("%s\n", line);
+    }
+  }
+  fclose(fp);
+  return 0;
+}
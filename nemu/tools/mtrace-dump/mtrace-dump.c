@@ -0,0 +1,68 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Print the memory access trace written by NEMU with CONFIG_MTRACE,
+ * one access in a line as
+ *   pc: R|W addr [len] = data
+ *
+ * Usage: make ARGS=FILE run
+ */
+
+#include <mtrace-def.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#define NR_CHUNK 4096
+
+static uint64_t load_le(const uint8_t *p, int len) {
+  uint64_t v = 0;
+  for (int i = len - 1; i >= 0; i --) v = (v << 8) | p[i];
+  return v;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s FILE\n", argv[0]);
+    return 1;
+  }
+  FILE *fp = fopen(argv[1], "rb");
+  if (fp == NULL) { perror(argv[1]); return 1; }
+
+  MtraceHeader h;
+  if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, MTRACE_MAGIC, sizeof(h.magic)) != 0) {
+    fprintf(stderr, "%s is not a memory access trace\n", argv[1]);
+    return 1;
+  }
+  assert(h.rec_size == h.pc_size + h.addr_size + h.data_size + 1);
+
+  static uint8_t buf[NR_CHUNK * 256];
+  size_t nr;
+  while ((nr = fread(buf, h.rec_size, NR_CHUNK, fp)) > 0) {
+    for (uint8_t *r = buf; r < buf + nr * h.rec_size; r += h.rec_size) {
+      uint64_t pc = load_le(r, h.pc_size);
+      uint64_t addr = load_le(r + h.pc_size, h.addr_size);
+      uint64_t data = load_le(r + h.pc_size + h.addr_size, h.data_size);
+      uint8_t len = r[h.rec_size - 1];
+      int n = len & ~MTRACE_WRITE;
+      if (n < 8) data &= ((uint64_t)1 << (n * 8)) - 1;  // the data of a store may have higher bits
+      printf("0x%0*" PRIx64 ": %c 0x%0*" PRIx64 " [%d] = 0x%0*" PRIx64 "\n", h.pc_size * 2, pc,
+          (len & MTRACE_WRITE ? 'W' : 'R'), h.addr_size * 2, addr, n, n * 2, data);
+    }
+  }
+  fclose(fp);
+  return 0;
+}
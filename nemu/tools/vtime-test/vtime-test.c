@@ -0,0 +1,93 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Generate a riscv32 image which reads the `time' CSR after a known
+ * number of instructions, run in a loop so that the block engines take
+ * it, and checks that it is that number divided by VIRTUAL_TIME_MIPS of
+ * the NEMU configuration. The image hits GOOD TRAP if the check passes.
+ *
+ * Usage: make run [NEMU=path/to/nemu]
+ */
+
+#include <common.h>
+#include <stdio.h>
+
+#define LOOP_US 1000 // guest time spent in the loop
+#define MAX_INST 64
+
+enum { zero = 0, t0 = 5, t1 = 6, t2 = 7, s0 = 8, a0 = 10 };
+enum { CSR_TIME = 0xc01 };
+
+static uint32_t img[MAX_INST];
+static int nr_inst = 0;
+
+static void emit(uint32_t inst) {
+  assert(nr_inst < MAX_INST);
+  img[nr_inst ++] = inst;
+}
+
+static int pc() { return nr_inst * 4; }
+
+static uint32_t i_type(int imm, int rs1, int f3, int rd, int op) {
+  return ((uint32_t)imm << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) | op;
+}
+
+static uint32_t b_type(int off, int rs2, int rs1, int f3) {
+  uint32_t imm = off;
+  return (((imm >> 12) & 1) << 31) | (((imm >> 5) & 0x3f) << 25) | (rs2 << 20) | (rs1 << 15) |
+    (f3 << 12) | (((imm >> 1) & 0xf) << 8) | (((imm >> 11) & 1) << 7) | 0x63;
+}
+
+#define LUI(rd, imm20)      emit(((uint32_t)(imm20) << 12) | ((rd) << 7) | 0x37)
+#define ADDI(rd, rs1, imm)  emit(i_type(imm, rs1, 0, rd, 0x13))
+#define CSRR(rd, csr)       emit(i_type(csr, zero, 2, rd, 0x73))
+#define BNE(rs1, rs2, off)  emit(b_type(off, rs2, rs1, 1))
+#define BLTU(rs1, rs2, off) emit(b_type(off, rs2, rs1, 6))
+#define EBREAK()            emit(0x00100073)
+
+// two instructions, so that the count before the loop is fixed
+static void li(int rd, uint32_t val) {
+  LUI(rd, (val + 0x800) >> 12);
+  ADDI(rd, rd, (int32_t)(val << 20) >> 20);
+}
+
+int main(int argc, char *argv[]) {
+  FILE *fp = (argc > 1 ? fopen(argv[1], "wb") : stdout);
+  assert(fp);
+
+  uint32_t nr_loop = (uint64_t)LOOP_US * CONFIG_VIRTUAL_TIME_MIPS / 2;
+  // instructions before the csrr, which may or may not count itself
+  uint64_t nr = 6 + 2 * (uint64_t)nr_loop;
+  li(t1, nr / CONFIG_VIRTUAL_TIME_MIPS);
+  li(t2, (nr + 1) / CONFIG_VIRTUAL_TIME_MIPS + 1);
+  li(s0, nr_loop);
+  int loop = pc();
+  ADDI(s0, s0, -1);
+  BNE(s0, zero, loop - pc());
+  CSRR(t0, CSR_TIME);
+
+  // a0 = (t1 <= t0 < t2 ? 0 : 1)
+  ADDI(a0, zero, 1);
+  BLTU(t0, t1, 16);
+  BLTU(t0, t2, 8);
+  EBREAK();
+  ADDI(a0, zero, 0);
+  EBREAK();
+
+  int ret = fwrite(img, 4, nr_inst, fp);
+  assert(ret == nr_inst);
+  fclose(fp);
+  return 0;
+}